@@ -2,9 +2,20 @@
 #define TRAILBUFFER_H
 
 #include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
 
 #include <glm/glm.hpp>
 
+/**
+ * Fixed capacity circular store of a bodies most recent positions.
+ * Appending overwrites the oldest point once full, storage is allocated once on the first append,
+ * so bodies that never log a trail (headless runs) cost no trail memory.
+ * Points live in slot order, the oldest point sits at head() once the buffer has wrapped.
+ * Bounds are kept for the points of the current and the previous capacity() appends, which together always cover
+ * everything still stored without rescanning the buffer when old points are overwritten.
+ */
 class TrailBuffer {
     public:
         std::vector<glm::vec3> trail_points;
@@ -13,29 +24,89 @@ class TrailBuffer {
         float trailDuration;
 
         TrailBuffer(float pollTime, float trailDuration) {
-            trailCount = trailDuration / pollTime;
+            this->trailDuration = trailDuration;
+            trailCount = std::max(1, static_cast<int>(trailDuration / pollTime));
         }
 
         void addTrailPoint(glm::vec3 p) {
-            trail_points.push_back(p);
+            if (trail_points.empty()) {
+                trail_points.resize(trailCount);
+            }
+            trail_points[next] = p;
+            next = (next + 1) % trailCount;
+            count = std::min(count + 1, trailCount);
+            added++;
 
-            if (trail_points.size() > trailCount) {
-                trail_points.erase(trail_points.begin());
+            generationMin[0] = glm::min(generationMin[0], p);
+            generationMax[0] = glm::max(generationMax[0], p);
+            if (added % trailCount == 0) {
+                // Every point the previous generation covered has now been overwritten
+                generationMin[1] = generationMin[0];
+                generationMax[1] = generationMax[0];
+                generationMin[0] = glm::vec3(std::numeric_limits<float>::max());
+                generationMax[0] = glm::vec3(-std::numeric_limits<float>::max());
             }
         }
 
         int size() const {
-            return trail_points.size();
+            return count;
+        }
+
+        int capacity() const {
+            return trailCount;
+        }
+
+        /**
+         * Slot the next point is written to, which is also the oldest point once the buffer is full
+         */
+        int head() const {
+            return next;
+        }
+
+        /**
+         * Points appended over the buffers lifetime, lets a consumer work out which slots changed since it last looked
+         */
+        uint64_t totalAdded() const {
+            return added;
         }
 
         const glm::vec3* data() const {
             return trail_points.data();
         }
 
+        /**
+         * Box around every stored point, possibly loose by up to capacity() points that were already overwritten
+         * Inverted (min above max) while the buffer is empty
+         */
+        glm::vec3 boundsMin() const {
+            return glm::min(generationMin[0], generationMin[1]);
+        }
+
+        glm::vec3 boundsMax() const {
+            return glm::max(generationMax[0], generationMax[1]);
+        }
+
         bool empty() const {
-            return trail_points.empty();
+            return count == 0;
+        }
+
+        void clear() {
+            next = 0;
+            count = 0;
+            added = 0;
+            for (int g = 0; g < 2; g++) {
+                generationMin[g] = glm::vec3(std::numeric_limits<float>::max());
+                generationMax[g] = glm::vec3(-std::numeric_limits<float>::max());
+            }
         }
 
+    private:
+        int next = 0;
+        int count = 0;
+        uint64_t added = 0;
+        // Bounds of the points appended since added was last a multiple of trailCount, and of the trailCount before those
+        glm::vec3 generationMin[2] = { glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::max()) };
+        glm::vec3 generationMax[2] = { glm::vec3(-std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max()) };
 };
 
 
@@ -0,0 +1,51 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+/**
+ * Lock-free single producer, single consumer triple buffer.
+ * The producer fills writeBuffer() and publish()es it, the consumer calls update() and reads readBuffer().
+ * Neither side ever waits: the producer always has a free buffer to write into and the consumer always sees the newest complete one.
+ */
+template <typename T>
+class TripleBuffer {
+    public:
+        T& writeBuffer() {
+            return buffers[back];
+        }
+
+        /**
+         * Hands the write buffer to the consumer and takes the spare one back for the next write
+         */
+        void publish() {
+            back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+        }
+
+        /**
+         * Swaps in the newest published buffer, if any was published since the last call
+         * @return true when readBuffer() changed
+         */
+        bool update() {
+            if ((middle.load(std::memory_order_acquire) & freshBit) == 0) {
+                return false;
+            }
+            front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+            return true;
+        }
+
+        const T& readBuffer() const {
+            return buffers[front];
+        }
+
+    private:
+        static constexpr int freshBit = 4;
+        static constexpr int indexMask = 3;
+
+        T buffers[3];
+        int back = 0;                   // Owned by the producer
+        int front = 1;                  // Owned by the consumer
+        std::atomic<int> middle{2};     // Spare buffer index, plus freshBit when it holds an unread publish
+};
+
+#endif //TRIPLEBUFFER_H
@@ -1,7 +1,7 @@
 #ifndef COLORS_H
 #define COLORS_H
 
-#include <glm\glm.hpp>
+#include <glm/glm.hpp>
 #include <unordered_map>
 #include <string>
 
@@ -0,0 +1,279 @@
+/*
+ * Bounding volume hierarchy over the bodies of a snapshot, used to cull them against the camera before anything is submitted.
+ * The tree is a binary median split over world space positions. Every node keeps the tight bounds of its bodies and their largest
+ * radius, and is refitted in place while the snapshot keeps its bodies, so the full build only runs when bodies come or go or the
+ * refitted bounds have had rebuildInterval snapshots to grow loose.
+ *
+ * The shaders pull every position towards the camera by the square root of its distance, so the world space frustum isn't a
+ * frustum at all. Instead, node bounds are carried into the compressed space the GPU actually clips in: a ball of radius rho at
+ * distance D from the eye maps into a ball of radius rho * zoom / sqrt(D - rho) around the compressed center, since the compression
+ * stretches nothing by more than zoom / sqrt(distance). That ball plus the largest compressed body radius is tested against the
+ * planes of projection * view.
+ */
+
+#ifndef OPENGLPRACTICE_FRUSTUMCULLER_H
+#define OPENGLPRACTICE_FRUSTUMCULLER_H
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "World/SimulationSnapshot.h"
+
+class FrustumCuller {
+    public:
+        struct Node {
+            glm::dvec3 boxMin;      // Tight bounds of the body centers beneath this node
+            glm::dvec3 boxMax;
+            double maxRadius;       // Largest body radius beneath this node
+            int firstChild;         // Index of the first of 2 contiguous children, -1 for a leaf
+            int bodyStart;          // Range of bodyIndices owned by this node
+            int bodyCount;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<int> bodyIndices;
+
+        int leafCapacity = 16;
+        // Snapshots refitted into the current topology before it is built again
+        int rebuildInterval = 64;
+
+        // Output of the last cull(), bodies inside the frustum. subPixel ones are known to be too small for any sphere
+        std::vector<int> visible;
+        std::vector<int> subPixel;
+        size_t nodesVisited = 0;
+
+        /**
+         * Fits the tree to the first count bodies of snapshot, nothing happens when it already is
+         * Rebuilt when the bodies changed, refitted when only their positions did
+         */
+        void update(const SimulationSnapshot& snapshot, size_t count) {
+            if (count == builtCount && snapshot.topology == builtTopology && snapshot.time == fittedTime) return;
+            if (count != builtCount || snapshot.topology != builtTopology || refits >= rebuildInterval) {
+                build(snapshot, count);
+                builtCount = count;
+                builtTopology = snapshot.topology;
+                refits = 0;
+            }
+            else {
+                refits++;
+            }
+            refit(snapshot);
+            fittedTime = snapshot.time;
+        }
+
+        /**
+         * Takes the clip planes of viewProjection, in the compressed space the shaders transform, for the following tests
+         * @param margin Extra width and height of the view in normalized device coordinates, so billboards overhanging the edge survive
+         */
+        void setFrustum(const glm::mat4& viewProjection, const glm::vec3& eye, float zoom, glm::vec2 margin) {
+            glm::dmat4 m(viewProjection);
+            auto row = [&](int r) {
+                return glm::dvec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+            };
+            // Left, right, bottom and top planes widened by the margin, then w > 0 in place of the near plane since
+            // billboards are drawn all the way up to the camera. Nothing is ever far enough out for the far plane to matter
+            planes[0] = (1.0 + margin.x) * row(3) + row(0);
+            planes[1] = (1.0 + margin.x) * row(3) - row(0);
+            planes[2] = (1.0 + margin.y) * row(3) + row(1);
+            planes[3] = (1.0 + margin.y) * row(3) - row(1);
+            planes[4] = row(3);
+            for (glm::dvec4& plane : planes) {
+                double length = glm::length(glm::dvec3(plane));
+                if (length > 0.0) plane /= length;
+            }
+            this->eye = glm::dvec3(eye);
+            this->zoom = zoom;
+        }
+
+        /**
+         * Collects every body whose sphere or billboard may land on screen into visible and subPixel
+         * @param minRatio Radius over distance below which a body gets no sphere, the renderer's last level of detail
+         */
+        void cull(const SimulationSnapshot& snapshot, double minRatio) {
+            visible.clear();
+            subPixel.clear();
+            nodesVisited = 0;
+            if (nodes.empty()) return;
+
+            stack.clear();
+            stack.push_back({ 0, allPlanes, false });
+            while (!stack.empty()) {
+                Entry entry = stack.back();
+                stack.pop_back();
+                const Node& node = nodes[entry.node];
+                nodesVisited++;
+
+                uint32_t mask = entry.mask;
+                bool small = entry.subPixel;
+                glm::dvec3 center = 0.5 * (node.boxMin + node.boxMax);
+                double rho = 0.5 * glm::length(node.boxMax - node.boxMin);
+                double distance = glm::length(center - eye);
+                // With the eye inside the node's ball the compressed bounds are unbounded, the children have to decide
+                if (distance > rho) {
+                    double near = distance - rho;
+                    if (mask != 0) {
+                        double radius = (rho / std::sqrt(near) + std::sqrt(node.maxRadius)) * zoom;
+                        if (!testSphere(compress(center), radius, mask)) continue;
+                    }
+                    small = small || node.maxRadius < minRatio * near;
+                }
+
+                if (mask == 0 && (small || node.firstChild < 0)) {
+                    // Entirely on screen, every body goes without a test of its own
+                    std::vector<int>& out = small ? subPixel : visible;
+                    out.insert(out.end(), bodyIndices.begin() + node.bodyStart, bodyIndices.begin() + node.bodyStart + node.bodyCount);
+                    continue;
+                }
+                if (node.firstChild >= 0) {
+                    stack.push_back({ node.firstChild, mask, small });
+                    stack.push_back({ node.firstChild + 1, mask, small });
+                    continue;
+                }
+                for (int k = node.bodyStart; k < node.bodyStart + node.bodyCount; k++) {
+                    int b = bodyIndices[k];
+                    uint32_t bodyMask = mask;
+                    if (!testSphere(compress(snapshot.positions[b]), std::sqrt(double(snapshot.radii[b])) * zoom, bodyMask)) continue;
+                    (small ? subPixel : visible).push_back(b);
+                }
+            }
+        }
+
+        /**
+         * Whether anything inside the world space box may land on screen, with the frustum of the last setFrustum()
+         */
+        bool boxVisible(const glm::dvec3& boxMin, const glm::dvec3& boxMax) const {
+            glm::dvec3 center = 0.5 * (boxMin + boxMax);
+            double rho = 0.5 * glm::length(boxMax - boxMin);
+            double distance = glm::length(center - eye);
+            if (distance <= rho) return true;
+            uint32_t mask = allPlanes;
+            return testSphere(compress(center), rho / std::sqrt(distance - rho) * zoom, mask);
+        }
+
+    private:
+        static constexpr int planeCount = 5;
+        static constexpr uint32_t allPlanes = (1u << planeCount) - 1;
+
+        struct Entry {
+            int node;
+            uint32_t mask;      // Planes the node's parent straddles, the ones it was entirely inside of are skipped
+            bool subPixel;
+        };
+
+        std::array<glm::dvec4, planeCount> planes;
+        glm::dvec3 eye = glm::dvec3(0.0);
+        double zoom = 1.0;
+
+        std::vector<Entry> stack;
+        std::vector<int> scratch;
+
+        size_t builtCount = std::numeric_limits<size_t>::max();
+        uint64_t builtTopology = 0;
+        double fittedTime = std::numeric_limits<double>::quiet_NaN();
+        int refits = 0;
+
+        /**
+         * Where the shaders put a world space position, relative to the eye and square root compressed
+         */
+        glm::dvec3 compress(const glm::dvec3& position) const {
+            glm::dvec3 relative = position - eye;
+            double r = glm::length(relative);
+            return r > 0.0 ? relative * (std::sqrt(r) * zoom / r) : relative;
+        }
+
+        /**
+         * False when the sphere is entirely outside one of the planes in mask
+         * Planes the sphere is entirely inside of are cleared from mask, so nothing beneath it tests them again
+         */
+        bool testSphere(const glm::dvec3& center, double radius, uint32_t& mask) const {
+            for (int p = 0; p < planeCount; p++) {
+                if (!(mask & (1u << p))) continue;
+                double distance = glm::dot(glm::dvec3(planes[p]), center) + planes[p].w;
+                if (distance < -radius) return false;
+                if (distance >= radius) mask &= ~(1u << p);
+            }
+            return true;
+        }
+
+        /**
+         * Median split along the longest axis of each node's bounds until leaves hold at most leafCapacity bodies
+         * Children are always appended after their parent, so refit() can sweep the nodes in reverse
+         */
+        void build(const SimulationSnapshot& snapshot, size_t count) {
+            nodes.clear();
+            bodyIndices.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                bodyIndices[i] = static_cast<int>(i);
+            }
+            if (count == 0) return;
+
+            nodes.push_back({ glm::dvec3(0.0), glm::dvec3(0.0), 0.0, -1, 0, static_cast<int>(count) });
+            scratch.clear();
+            scratch.push_back(0);
+            while (!scratch.empty()) {
+                int n = scratch.back();
+                scratch.pop_back();
+                int start = nodes[n].bodyStart;
+                int bodyCount = nodes[n].bodyCount;
+                if (bodyCount <= leafCapacity) continue;
+
+                glm::dvec3 lo(std::numeric_limits<double>::max()), hi(-std::numeric_limits<double>::max());
+                for (int k = start; k < start + bodyCount; k++) {
+                    lo = glm::min(lo, snapshot.positions[bodyIndices[k]]);
+                    hi = glm::max(hi, snapshot.positions[bodyIndices[k]]);
+                }
+                glm::dvec3 extent = hi - lo;
+                int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+                // Bodies sharing one spot can't be split
+                if (extent[axis] <= 0.0) continue;
+
+                int half = bodyCount / 2;
+                auto first = bodyIndices.begin() + start;
+                std::nth_element(first, first + half, first + bodyCount, [&](int a, int b) {
+                    return snapshot.positions[a][axis] < snapshot.positions[b][axis];
+                });
+
+                int child = static_cast<int>(nodes.size());
+                nodes[n].firstChild = child;
+                nodes.push_back({ glm::dvec3(0.0), glm::dvec3(0.0), 0.0, -1, start, half });
+                nodes.push_back({ glm::dvec3(0.0), glm::dvec3(0.0), 0.0, -1, start + half, bodyCount - half });
+                scratch.push_back(child);
+                scratch.push_back(child + 1);
+            }
+        }
+
+        /**
+         * Recomputes the bounds and radii of every node from the current positions, bottom-up
+         */
+        void refit(const SimulationSnapshot& snapshot) {
+            for (int n = static_cast<int>(nodes.size()) - 1; n >= 0; n--) {
+                Node& node = nodes[n];
+                if (node.firstChild < 0) {
+                    node.boxMin = glm::dvec3(std::numeric_limits<double>::max());
+                    node.boxMax = glm::dvec3(-std::numeric_limits<double>::max());
+                    node.maxRadius = 0.0;
+                    for (int k = node.bodyStart; k < node.bodyStart + node.bodyCount; k++) {
+                        int b = bodyIndices[k];
+                        node.boxMin = glm::min(node.boxMin, snapshot.positions[b]);
+                        node.boxMax = glm::max(node.boxMax, snapshot.positions[b]);
+                        node.maxRadius = std::max(node.maxRadius, double(snapshot.radii[b]));
+                    }
+                }
+                else {
+                    const Node& left = nodes[node.firstChild];
+                    const Node& right = nodes[node.firstChild + 1];
+                    node.boxMin = glm::min(left.boxMin, right.boxMin);
+                    node.boxMax = glm::max(left.boxMax, right.boxMax);
+                    node.maxRadius = std::max(left.maxRadius, right.maxRadius);
+                }
+            }
+        }
+};
+
+#endif //OPENGLPRACTICE_FRUSTUMCULLER_H
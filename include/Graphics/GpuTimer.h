@@ -0,0 +1,101 @@
+/*
+ * GL_TIME_ELAPSED query timers that file GPU time per phase with the Profiler.
+ * Every phase cycles through a few query objects and only reads back a query once GL reports it as available,
+ * so timing never stalls the pipeline. A frame whose query slot is still busy simply isn't measured.
+ * Time elapsed queries can't nest, so only sequential phases of the frame are wrapped.
+ * Like the CPU timers it compiles away completely without OPENGLPRACTICE_PROFILE.
+ */
+
+#ifndef OPENGLPRACTICE_GPUTIMER_H
+#define OPENGLPRACTICE_GPUTIMER_H
+
+#include "Util/Profiler.h"
+
+#ifdef OPENGLPRACTICE_PROFILE
+
+#include <glad/glad.h>
+
+class GpuTimer {
+    public:
+        // Queries in flight per phase, enough for the driver to run a few frames behind
+        static constexpr int slotCount = 4;
+
+        GpuTimer(const char* name) : phase(Profiler::instance().phase(name)) {
+            glGenQueries(slotCount, queries);
+        }
+
+        // No destructor, the timers are statics that outlive the context and their queries go with it
+
+        GpuTimer(const GpuTimer&) = delete;
+        GpuTimer& operator=(const GpuTimer&) = delete;
+
+        void begin() {
+            collect();
+            active = !pending[next];
+            if (active) {
+                submitted[next] = Profiler::Clock::now();
+                glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+            }
+        }
+
+        void end() {
+            if (!active) return;
+            glEndQuery(GL_TIME_ELAPSED);
+            pending[next] = true;
+            next = (next + 1) % slotCount;
+        }
+
+    private:
+        uint32_t phase;
+        unsigned int queries[slotCount];
+        bool pending[slotCount] = {};
+        Profiler::Clock::time_point submitted[slotCount];
+        int next = 0;
+        bool active = false;
+
+        /**
+         * Files every finished query with the profiler, without waiting on any that aren't
+         */
+        void collect() {
+            for (int i = 0; i < slotCount; i++) {
+                if (!pending[i]) continue;
+                GLint available = 0;
+                glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available) continue;
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+                Profiler::instance().recordGpu(phase, submitted[i], elapsed * 1e-9);
+                pending[i] = false;
+            }
+        }
+};
+
+/**
+ * Brackets the rest of the enclosing block with one GpuTimer
+ */
+class GpuTimerScope {
+    public:
+        GpuTimerScope(GpuTimer& timer) : timer(timer) {
+            timer.begin();
+        }
+
+        ~GpuTimerScope() {
+            timer.end();
+        }
+
+    private:
+        GpuTimer& timer;
+};
+
+// The timer is created on first use, which must be on the thread holding the GL context
+#define PROFILE_GPU_SCOPE(name) \
+    static GpuTimer PROFILE_CONCAT(gpuTimer, __LINE__)(name); \
+    GpuTimerScope PROFILE_CONCAT(gpuTimerScope, __LINE__)(PROFILE_CONCAT(gpuTimer, __LINE__))
+
+#else
+
+#define PROFILE_GPU_SCOPE(name) ((void)0)
+
+#endif // OPENGLPRACTICE_PROFILE
+
+#endif //OPENGLPRACTICE_GPUTIMER_H
@@ -5,12 +5,38 @@
 #include <glad/glad.h>
 
 #include <iostream>
+#include <algorithm>
 #include <any>
 #include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <cmath>
 
 #include "Graphics/Camera.h"
 #include "Graphics/Shader.h"
-#include "World/CelestialObject.h"
+#include "Graphics/SphereMesh.h"
+#include "Graphics/SphereMeshCache.h"
+#include "Graphics/FrustumCuller.h"
+#include "Graphics/GpuTimer.h"
+#include "World/Simulation.h"
+
+/**
+ * Per body attributes for the instanced sphere draw, laid out to match the attribute pointers set in bindInstanceAttributes()
+ */
+struct BodyInstance {
+    glm::vec3 position;     // World space position, compressed in instanced.glsl
+    float radius;
+    glm::vec3 color;
+};
+
+/**
+ * One sphere level of detail, used for bodies whose radius on screen is at least minPixels
+ */
+struct SphereLod {
+    int segments;
+    float minPixels;
+};
 
 class Renderer {
     public:
@@ -23,7 +49,47 @@ class Renderer {
         float ASPECT_RATIO;
         float zoomFactor = 1.0f;
 
-        Renderer(float FOV) {
+        // Geometry shared by every body, one sphere per level of detail
+        SphereMeshCache sphereMeshes;
+        std::vector<float> billboardCoordinates;
+        unsigned int billboard_VAO;
+
+        // Sphere levels of detail, finest first. Bodies take the first level their projected radius reaches,
+        // bodies smaller on screen than the last level are only drawn as billboards
+        std::vector<SphereLod> sphereLods;
+
+        // Bodies that may be on screen this frame, only these get instances and trails drawn
+        FrustumCuller culler;
+        std::vector<uint8_t> trailVisible;
+
+        // Per body instance data grouped by level of detail, each group goes out in one instanced draw call
+        // lodFirst and lodCount hold one entry per level plus a last one for the billboard only bodies
+        std::vector<BodyInstance> instances;
+        std::vector<size_t> lodFirst, lodCount;
+        unsigned int instance_VBO;
+        size_t instanceCapacity = 0;
+        // Snapshot time, body count and camera the instances were culled and sorted for, the upload is skipped while none change
+        double instanceTime = std::numeric_limits<double>::quiet_NaN();
+        size_t instanceBodies = 0;
+        glm::vec3 instanceCameraPos = glm::vec3(std::numeric_limits<float>::quiet_NaN());
+        glm::vec3 instanceCameraFront = glm::vec3(std::numeric_limits<float>::quiet_NaN());
+        float instanceZoom = std::numeric_limits<float>::quiet_NaN();
+
+        // Billboard icon radius in pixels
+        float billboardSize = 2.0f;
+
+        /**
+         * @param segments Segment count of the finest sphere, coarser levels halve it down to 4
+         */
+        Renderer(float FOV, int segments = 32) : billboardCoordinates(SphereMesh::billboardCoordinates(segments)) {
+            float minPixels = 64.0f;
+            for (int lodSegments = segments; lodSegments >= 4; lodSegments /= 2) {
+                sphereLods.push_back({ lodSegments, minPixels });
+                minPixels /= 4.0f;
+            }
+            // Spheres still get drawn down to a single pixel, below that the billboard alone shows the body
+            sphereLods.back().minPixels = std::min(sphereLods.back().minPixels, 1.0f);
+
             glfwInit();
             glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
             glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -61,6 +127,7 @@ class Renderer {
                 "..\\shaders\\fragment.glsl",
                 "..\\shaders\\billboard.glsl",
                 "..\\shaders\\bFragment.glsl",
+                "..\\shaders\\instanced.glsl",
                 ASPECT_RATIO
                 );
             camera = std::make_unique<Camera>(FOV, SCR_WIDTH, SCR_HEIGHT);
@@ -68,51 +135,19 @@ class Renderer {
             glDisable(GL_CULL_FACE);
             glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);  // Comment this line out for sphere view
             glfwSetWindowPos(window, 0.0f, 0.0f);
-        }
-
-        void bufferObject(std::unique_ptr<CelestialObject>& object) {
-            // Init buffers
-            unsigned int VBO, VAO, EBO;
-            glGenVertexArrays(1, &VAO);
-            glGenBuffers(1, &VBO);
-            glGenBuffers(1, &EBO);
-
-            // Buffer object data
-            glBindVertexArray(VAO);
-
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER,
-                object->NDC_coordinates.size() * sizeof(float),
-                object->NDC_coordinates.data(),
-                GL_STATIC_DRAW
-                );
-
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                object->NDC_indices.size() * sizeof(int),
-                object->NDC_indices.data(),
-                GL_STATIC_DRAW
-                );
-
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-            glEnableVertexAttribArray(0);
 
-            // Store ptr and VAO in map
-            object->vertices_VAO = VAO;
-
-            // Trail buffer initialization
-            unsigned int trailVBO, trailVAO;
-            glGenVertexArrays(1, &trailVAO);
-            glGenBuffers(1, &trailVBO);
-
-            glBindVertexArray(trailVAO);
-            glBindBuffer(GL_ARRAY_BUFFER, trailVBO);
-
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-            glEnableVertexAttribArray(0);
+            bufferMeshes();
+        }
 
-            object->trail_VBO = trailVBO;
-            object->trail_VAO = trailVAO;
+        /**
+         * Uploads the sphere of every level of detail and the billboard mesh, every body is drawn through these VAOs
+         * All of them also source the per instance attributes from instance_VBO, one BodyInstance per body
+         */
+        void bufferMeshes() {
+            glGenBuffers(1, &instance_VBO);
+            for (const SphereLod& lod : sphereLods) {
+                sphereMeshes.get(lod.segments);
+            }
 
             ////////////////////
             // VAO for billboard object
@@ -123,12 +158,72 @@ class Renderer {
 
             glBindVertexArray(billboardVAO);
             glBindBuffer(GL_ARRAY_BUFFER, billboardVBO);
-            glBufferData(GL_ARRAY_BUFFER, object->billboard_coordinates.size() * sizeof(float), object->billboard_coordinates.data(), GL_STATIC_DRAW);
+            glBufferData(GL_ARRAY_BUFFER, billboardCoordinates.size() * sizeof(float), billboardCoordinates.data(), GL_STATIC_DRAW);
 
             glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
             glEnableVertexAttribArray(0);
 
-            object->billboard_VAO = billboardVAO;
+            // Billboards read the same instance buffer as the spheres, only position and color are used
+            bindInstanceAttributes(0, false);
+
+            billboard_VAO = billboardVAO;
+
+            // Cleanup
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindVertexArray(0);
+        }
+
+        /**
+         * Points the instance attributes of the bound VAO at instance_VBO, starting from instance first
+         * GL 3.3 has no base instance draws, so each level of detail group is drawn by moving these pointers to its start
+         */
+        void bindInstanceAttributes(size_t first, bool withRadius) {
+            size_t base = first * sizeof(BodyInstance);
+            glBindBuffer(GL_ARRAY_BUFFER, instance_VBO);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(BodyInstance), (void*)(base + offsetof(BodyInstance, position)));
+            glEnableVertexAttribArray(1);
+            glVertexAttribDivisor(1, 1);
+            if (withRadius) {
+                glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(BodyInstance), (void*)(base + offsetof(BodyInstance, radius)));
+                glEnableVertexAttribArray(2);
+                glVertexAttribDivisor(2, 1);
+            }
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(BodyInstance), (void*)(base + offsetof(BodyInstance, color)));
+            glEnableVertexAttribArray(3);
+            glVertexAttribDivisor(3, 1);
+        }
+
+        /**
+         * Creates the per body trail buffers for every body in the simulation that doesn't have one yet
+         * Each buffer is sized once for the full trail plus one slot that mirrors slot 0, so a wrapped trail draws without a gap
+         * Handles are stored in the simulations render table
+         */
+        void bufferObjects(Simulation& sim) {
+            RenderTable& render = sim.render;
+            // Trails of bodies removed by RenderTable::sync()
+            if (!render.retired_VBO.empty()) {
+                glDeleteBuffers(static_cast<GLsizei>(render.retired_VBO.size()), render.retired_VBO.data());
+                glDeleteVertexArrays(static_cast<GLsizei>(render.retired_VAO.size()), render.retired_VAO.data());
+                render.retired_VBO.clear();
+                render.retired_VAO.clear();
+            }
+            for (size_t i = render.trail_VAO.size(); i < render.size(); i++) {
+                // Trail buffer initialization
+                unsigned int trailVBO, trailVAO;
+                glGenVertexArrays(1, &trailVAO);
+                glGenBuffers(1, &trailVBO);
+
+                glBindVertexArray(trailVAO);
+                glBindBuffer(GL_ARRAY_BUFFER, trailVBO);
+                glBufferData(GL_ARRAY_BUFFER, (render.trails[i].capacity() + 1) * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+                glEnableVertexAttribArray(0);
+
+                render.trail_VBO.push_back(trailVBO);
+                render.trail_VAO.push_back(trailVAO);
+                render.trail_uploaded.push_back(0);
+            }
 
             // Cleanup
             glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -139,89 +234,203 @@ class Renderer {
         /**
          * Intended replacement for drawObject()
          * Does not change any buffer data, rather accesses and draws all vaos with object data considered.
-         * Grabs all keys from hashmap to get access to VAOs and relevant object data
+         * Positions come from a simulation snapshot rather than the live simulation, which may be stepping on another thread
+         * Spheres go out in one instanced draw call per level of detail, billboards in one more, trails are still drawn per body
+         * Bodies and trails outside the view frustum are culled on the CPU first, so only what may be on screen is submitted
+         * All geometry is uploaded in world space, the shaders apply the camera offset and sqrt compression
          */
-        void drawBuffers(Simulation& sim) {
-            for (const auto& object : sim.objects) {    //OBJECT_PTR IS NOT A CORRECT NAME
-                // Object rendering
-                float radius = object->radius;
-
-                glm::mat4 model = glm::mat4(1.0f);
-                glm::vec3 relative_pos = object->position - camera->cameraPos;
-                glm::vec3 compressedPosition = compressSqrt(relative_pos, zoomFactor);
-                glm::vec3 compressedRadius = compressSqrt(glm::vec3(radius), zoomFactor);
-                model = glm::translate(model, compressedPosition);
-                model = glm::scale(model, compressedRadius);
-
-                use_vertex(model, camera->view, camera->perspective_projection, object->color);
-
-                glBindVertexArray(object->vertices_VAO);
-                glDrawElements(GL_TRIANGLES, object->NDC_indices.size(), GL_UNSIGNED_INT, 0);
-
-                //////////////////
-                // Trail rendering
-                //////////////////
-                updateTrailBuffer(object.get());
-
-                // shader->set_model(model);
-                glBindVertexArray(object->trail_VAO);
-                glDrawArrays(GL_LINE_STRIP, 0, object->trail_points.size());
+        void drawBuffers(const SimulationSnapshot& snapshot, RenderTable& render) {
+            size_t count = std::min(snapshot.size(), render.size());
+
+            // Object rendering
+            if (snapshot.time != instanceTime || count != instanceBodies || camera->cameraPos != instanceCameraPos
+                || camera->cameraFront != instanceCameraFront || zoomFactor != instanceZoom) {
+                cullBodies(snapshot, count);
+                {
+                    PROFILE_SCOPE("body upload");
+                    sortInstances(snapshot, render);
+                    updateInstanceBuffer();
+                }
+                instanceTime = snapshot.time;
+                instanceBodies = count;
+                instanceCameraPos = camera->cameraPos;
+                instanceCameraFront = camera->cameraFront;
+                instanceZoom = zoomFactor;
+            }
+
+            {
+                PROFILE_SCOPE("body draw");
+                PROFILE_GPU_SCOPE("body draw");
+                shader->use_instanced(camera->view, camera->perspective_projection, camera->cameraPos, zoomFactor);
+                for (size_t level = 0; level < sphereLods.size(); level++) {
+                    if (lodCount[level] == 0) continue;
+                    const GpuMesh& mesh = sphereMeshes.get(sphereLods[level].segments);
+                    glBindVertexArray(mesh.VAO);
+                    bindInstanceAttributes(lodFirst[level], true);
+                    glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0, lodCount[level]);
+                }
             }
 
+            //////////////////
+            // Trail rendering
+            //////////////////
+            {
+                PROFILE_SCOPE("trail upload");
+                trailVisible.resize(count);
+                for (size_t i = 0; i < count; i++) {
+                    const TrailBuffer& trail = render.trails[i];
+                    trailVisible[i] = !trail.empty() && culler.boxVisible(glm::dvec3(trail.boundsMin()), glm::dvec3(trail.boundsMax()));
+                    // Culled trails keep their pending points, which go up once the trail comes back into view
+                    if (!trailVisible[i]) continue;
+                    updateTrailBuffer(render.trail_VBO[i], render.trails[i], render.trail_uploaded[i]);
+                }
+            }
+            drawTrails(render, count);
+
             // 2D screen space renders
             glDisable(GL_DEPTH_TEST);
 
-            for (const auto& object : sim.objects) {
-                glm::vec3 rel_pos = object->position - camera->cameraPos;
-                glm::vec3 compressedPosition = compressSqrt(rel_pos, zoomFactor);
+            // Draw planet billboard icons in one instanced call, projected and culled to the screen in billboard.glsl
+            {
+                PROFILE_SCOPE("billboard draw");
+                PROFILE_GPU_SCOPE("billboard draw");
+                use_billboard(camera->ortho_projection, camera->view, camera->perspective_projection, camera->cameraPos, zoomFactor,
+                              glm::vec2(SCR_WIDTH, SCR_HEIGHT), billboardSize);
+                glBindVertexArray(billboard_VAO);
+                glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, billboardCoordinates.size() / 2, instances.size());
+            }
 
-                // Draw planet billboard icons
-                glm::vec4 clip = camera->perspective_projection * camera->view * glm::vec4(compressedPosition, 1.0f);
-                if (clip.w <= 0.0f) continue;
+            glEnable(GL_DEPTH_TEST);
+        }
 
-                glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        /**
+         * One line strip per body from the already uploaded trail buffers, skipping the trails culled this frame
+         */
+        void drawTrails(RenderTable& render, size_t count) {
+            PROFILE_SCOPE("trail draw");
+            PROFILE_GPU_SCOPE("trail draw");
+            for (size_t i = 0; i < count; i++) {
+                if (!trailVisible[i]) continue;
+                const TrailBuffer& trail = render.trails[i];
+                use_vertex(glm::mat4(1.0f), camera->view, camera->perspective_projection, render.colors[i], camera->cameraPos, zoomFactor);
+                glBindVertexArray(render.trail_VAO[i]);
+                if (trail.size() < trail.capacity() || trail.head() == 0) {
+                    glDrawArrays(GL_LINE_STRIP, 0, trail.size());
+                }
+                else {
+                    // Wrapped, oldest points run from head through the mirrored slot 0, then on to the newest
+                    glDrawArrays(GL_LINE_STRIP, trail.head(), trail.capacity() + 1 - trail.head());
+                    glDrawArrays(GL_LINE_STRIP, 0, trail.head());
+                }
+            }
+        }
 
-                float x = (ndc.x + 1.0f) * 0.5f * SCR_WIDTH;
-                float y = (1.0f - ndc.y) * 0.5f * SCR_HEIGHT;
-                // Add conditional to not render if the x or y is past screen bounds
+        /**
+         * Radius over distance a body needs for each sphere level of detail, from its minimum size in pixels
+         * The radius on screen follows the shaders' compression: both the radius and the camera distance are square rooted,
+         * so a body covers about sqrt(radius / distance) of the view, whatever the zoom
+         */
+        std::vector<double> lodMinRatios() const {
+            float pixelsPerRadian = SCR_HEIGHT / (2.0f * std::tan(glm::radians(camera->FOV) * 0.5f));
+            std::vector<double> minRatio(sphereLods.size());
+            for (size_t level = 0; level < sphereLods.size(); level++) {
+                // Squared pixels over squared pixels per radian
+                minRatio[level] = double(sphereLods[level].minPixels) * sphereLods[level].minPixels / (double(pixelsPerRadian) * pixelsPerRadian);
+            }
+            return minRatio;
+        }
 
-                glm::mat4 screenPosition = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
-                screenPosition = glm::scale(screenPosition, glm::vec3(2.0f, 2.0f, 0.0f));
+        /**
+         * Refits the culling tree to the snapshot and collects the bodies whose sphere or billboard may be on screen
+         * Bodies in subtrees too small on screen for the last level of detail are marked billboard only without a look at each
+         */
+        void cullBodies(const SimulationSnapshot& snapshot, size_t count) {
+            PROFILE_SCOPE("cull");
+            culler.update(snapshot, count);
+            // Billboards reach billboardSize pixels past their center, the frustum is widened to keep ones overhanging the edge
+            glm::vec2 margin(2.0f * billboardSize / SCR_WIDTH, 2.0f * billboardSize / SCR_HEIGHT);
+            culler.setFrustum(camera->perspective_projection * camera->view, camera->cameraPos, zoomFactor, margin);
+            culler.cull(snapshot, lodMinRatios().back());
+        }
 
-                use_billboard(camera->ortho_projection, screenPosition, object->color);
-                glBindVertexArray(object->billboard_VAO);
-                glDrawArrays(GL_TRIANGLE_FAN, 0, object->billboard_coordinates.size() / 2);
+        /**
+         * Fills instances with the bodies that survived culling, grouped by level of detail, finest level first
+         * and the billboard only bodies last
+         */
+        void sortInstances(const SimulationSnapshot& snapshot, const RenderTable& render) {
+            size_t levels = sphereLods.size();
+            std::vector<double> minRatio = lodMinRatios();
+            const std::vector<int>& visible = culler.visible;
+            const std::vector<int>& subPixel = culler.subPixel;
+
+            instanceLevels.resize(visible.size());
+            lodCount.assign(levels + 1, 0);
+            lodCount[levels] = subPixel.size();
+            glm::dvec3 eye(camera->cameraPos);
+            for (size_t v = 0; v < visible.size(); v++) {
+                int i = visible[v];
+                double distance = glm::length(snapshot.positions[i] - eye);
+                double ratio = distance > snapshot.radii[i] ? snapshot.radii[i] / distance : 1.0;
+                uint8_t level = 0;
+                while (level < levels && ratio < minRatio[level]) level++;
+                instanceLevels[v] = level;
+                lodCount[level]++;
             }
 
-            glEnable(GL_DEPTH_TEST);
+            lodFirst.assign(levels + 1, 0);
+            for (size_t level = 1; level <= levels; level++) {
+                lodFirst[level] = lodFirst[level - 1] + lodCount[level - 1];
+            }
+            std::vector<size_t> next = lodFirst;
+            instances.resize(visible.size() + subPixel.size());
+            auto write = [&](int i, uint8_t level) {
+                BodyInstance& instance = instances[next[level]++];
+                instance.position = glm::vec3(snapshot.positions[i]);
+                instance.radius = snapshot.radii[i];
+                instance.color = render.colors[i];
+            };
+            for (size_t v = 0; v < visible.size(); v++) {
+                write(visible[v], instanceLevels[v]);
+            }
+            for (int i : subPixel) {
+                write(i, static_cast<uint8_t>(levels));
+            }
         }
 
-        glm::vec3 compressSqrt(const glm::vec3& pos, float scale) {
-            float r = glm::length(pos);
-            if (r == 0.0f) return pos;
-            float r_c = sqrt(r) * scale;
-            return glm::normalize(pos) * r_c;
+        /**
+         * Pushes this frame's instances to instance_VBO, the buffer is only reallocated when the body count outgrows it
+         */
+        void updateInstanceBuffer() {
+            glBindBuffer(GL_ARRAY_BUFFER, instance_VBO);
+            if (instances.size() > instanceCapacity) {
+                instanceCapacity = std::max(instances.size(), instanceCapacity * 2);
+                glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(BodyInstance), nullptr, GL_DYNAMIC_DRAW);
+            }
+            glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(BodyInstance), instances.data());
         }
 
         /**
-         * Method that updates the buffers present in line_map to reflect the current line points
+         * Uploads only the trail points appended since the last call, in at most two ranges when they straddle the wrap
+         * Points go up in world space, the vertex shader applies the camera offset and compression, so zooming costs no upload
          */
-        void updateTrailBuffer(const CelestialObject* object) {
-            unsigned int trailVBO = object->trail_VBO;
-            std::vector<glm::vec3> zoomedPoints;
-
-            std::vector<glm::vec3> trail_pts = object->trail_points.trail_points;
-            for (const auto& position_vec : trail_pts) {
-                glm::vec3 compressedPoint = compressSqrt(position_vec, zoomFactor);
-                zoomedPoints.push_back(compressedPoint);
-            }
+        void updateTrailBuffer(unsigned int trailVBO, const TrailBuffer& trail, uint64_t& uploaded) {
+            int capacity = trail.capacity();
+            int pending = static_cast<int>(std::min<uint64_t>(trail.totalAdded() - uploaded, capacity));
+            uploaded = trail.totalAdded();
+            if (pending == 0) return;
 
-            // Pushes data to buffer, VAO automatically picks it up
             glBindBuffer(GL_ARRAY_BUFFER, trailVBO);
-            glBufferData(GL_ARRAY_BUFFER,
-                zoomedPoints.size() * sizeof(glm::vec3),
-                zoomedPoints.data(),
-                GL_DYNAMIC_DRAW);
+            int start = (trail.head() - pending + capacity) % capacity;
+            int firstCount = std::min(pending, capacity - start);
+            glBufferSubData(GL_ARRAY_BUFFER, start * sizeof(glm::vec3), firstCount * sizeof(glm::vec3), trail.data() + start);
+            if (firstCount < pending) {
+                glBufferSubData(GL_ARRAY_BUFFER, 0, (pending - firstCount) * sizeof(glm::vec3), trail.data());
+            }
+
+            // Slot 0 is mirrored past the end so the wrapped trail stays one connected strip
+            if (start == 0 || firstCount < pending) {
+                glBufferSubData(GL_ARRAY_BUFFER, capacity * sizeof(glm::vec3), sizeof(glm::vec3), trail.data());
+            }
         }
 
         /**
@@ -237,12 +446,12 @@ class Renderer {
             shader->set_projection(camera->perspective_projection);
         }
 
-        void use_vertex(glm::mat4 model, glm::mat4 view, glm::mat4 projection, glm::vec3 color) {
-            shader->use_vertex(model, view, projection, color);
+        void use_vertex(glm::mat4 model, glm::mat4 view, glm::mat4 projection, glm::vec3 color, glm::vec3 cameraPos, float zoomFactor) {
+            shader->use_vertex(model, view, projection, color, cameraPos, zoomFactor);
         }
 
-        void use_billboard(glm::mat4 ortho, glm::mat4 screenPosition, glm::vec3 color) {
-            shader->use_billboard(ortho, screenPosition, color);
+        void use_billboard(glm::mat4 ortho, glm::mat4 view, glm::mat4 projection, glm::vec3 cameraPos, float zoomFactor, glm::vec2 screenSize, float size) {
+            shader->use_billboard(ortho, view, projection, cameraPos, zoomFactor, screenSize, size);
         }
 
         void update_camera_position(CameraMovement direction, float cameraSpeed) const {
@@ -251,6 +460,9 @@ class Renderer {
 
 
     private:
+        // Level of detail of every visible body, scratch for sortInstances()
+        std::vector<uint8_t> instanceLevels;
+
         static void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
             glViewport(0, 0, width, height);
         }
@@ -10,39 +10,47 @@
 
 class Shader {
 public:
-    unsigned int vertexProgram, billboardProgram;
+    unsigned int vertexProgram, billboardProgram, instancedProgram;
 
     // Shader Uniform Locations for vertex.glsl
-    int modelLocation, viewLocation, projectionLocation, colorLocation;
+    int modelLocation, viewLocation, projectionLocation, colorLocation, cameraPosLocation, zoomFactorLocation;
 
     // Shader Uniform Locations for billboard.glsl
-    int orthoLocation, billboardSizeLocation, screenPositionLocation, bColorLocation;
+    int orthoLocation, billboardSizeLocation;
+    int bViewLocation, bProjectionLocation, bCameraPosLocation, bZoomFactorLocation, bScreenSizeLocation;
 
-    Shader(const char* vertexPath, const char* fragmentPath, const char* billboardPath, const char* bFragmentPath, float aspect) {
+    // Shader Uniform Locations for instanced.glsl
+    int instancedViewLocation, instancedProjectionLocation, instancedCameraPosLocation, instancedZoomFactorLocation;
+
+    Shader(const char* vertexPath, const char* fragmentPath, const char* billboardPath, const char* bFragmentPath, const char* instancedPath, float aspect) {
         // File and data objects
-        std::string vertexCode, fragmentCode, billboardCode, bFragmentCode;
-        std::ifstream vertexFile,fragmentFile, billboardFile, bFragmentFile;
+        std::string vertexCode, fragmentCode, billboardCode, bFragmentCode, instancedCode;
+        std::ifstream vertexFile,fragmentFile, billboardFile, bFragmentFile, instancedFile;
         try {
             vertexFile.open(vertexPath);
             fragmentFile.open(fragmentPath);
             billboardFile.open(billboardPath);
             bFragmentFile.open(bFragmentPath);
+            instancedFile.open(instancedPath);
             // File contents into stream
-            std::stringstream vertexStream, fragmentStream, billboardStream, bFragmentStream;
+            std::stringstream vertexStream, fragmentStream, billboardStream, bFragmentStream, instancedStream;
             vertexStream << vertexFile.rdbuf();
             fragmentStream << fragmentFile.rdbuf();
             billboardStream << billboardFile.rdbuf();
             bFragmentStream << bFragmentFile.rdbuf();
+            instancedStream << instancedFile.rdbuf();
             // Close file instances
             vertexFile.close();
             fragmentFile.close();
             billboardFile.close();
             bFragmentFile.close();
+            instancedFile.close();
             // Convert strings to stream
             vertexCode = vertexStream.str();
             fragmentCode = fragmentStream.str();
             billboardCode = billboardStream.str();
             bFragmentCode = bFragmentStream.str();
+            instancedCode = instancedStream.str();
         }
         catch (std::ifstream::failure e) {
             std::cout << "ERROR::SHADER::FILE_IO_ERROR" << std::endl;
@@ -52,22 +60,26 @@ public:
         const char* fragmentShaderCode = fragmentCode.c_str();
         const char* billboardShaderCode = billboardCode.c_str();
         const char* bFragmentShaderCode = bFragmentCode.c_str();
+        const char* instancedShaderCode = instancedCode.c_str();
 
         // Compile shaders
-        unsigned int vertex, fragment, billboard, bFragment;
+        unsigned int vertex, fragment, billboard, bFragment, instanced;
 
         vertex = glCreateShader(GL_VERTEX_SHADER);
         billboard = glCreateShader(GL_VERTEX_SHADER);
+        instanced = glCreateShader(GL_VERTEX_SHADER);
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         bFragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(vertex, 1, &vertexShaderCode, NULL);
         glShaderSource(fragment, 1, &fragmentShaderCode, NULL);
         glShaderSource(billboard, 1, &billboardShaderCode, NULL);
         glShaderSource(bFragment, 1, &bFragmentShaderCode, NULL);
+        glShaderSource(instanced, 1, &instancedShaderCode, NULL);
         glCompileShader(vertex);
         glCompileShader(fragment);
         glCompileShader(billboard);
         glCompileShader(bFragment);
+        glCompileShader(instanced);
 
         vertexProgram = glCreateProgram();
         glAttachShader(vertexProgram, vertex);
@@ -79,30 +91,49 @@ public:
         glAttachShader(billboardProgram, bFragment);
         glLinkProgram(billboardProgram);
 
+        // Instanced bodies share the plain fragment shader
+        instancedProgram = glCreateProgram();
+        glAttachShader(instancedProgram, instanced);
+        glAttachShader(instancedProgram, fragment);
+        glLinkProgram(instancedProgram);
+
         // Error checking
         checkCompileErrors(vertex, "VERTEX");
         checkCompileErrors(fragment, "FRAGMENT");
         checkCompileErrors(billboard, "BILLBOARD");
         checkCompileErrors(bFragment, "B-FRAGMENT");
+        checkCompileErrors(instanced, "INSTANCED");
         checkCompileErrors(vertexProgram, "PROGRAM");
         checkCompileErrors(billboardProgram, "BILLBOARD");
+        checkCompileErrors(instancedProgram, "PROGRAM");
 
         // Delete shaders
         glDeleteShader(vertex);
         glDeleteShader(fragment);
         glDeleteShader(billboard);
         glDeleteShader(bFragment);
+        glDeleteShader(instanced);
 
         // Shader uniform initialization
         modelLocation = glGetUniformLocation(vertexProgram, "model");
         viewLocation = glGetUniformLocation(vertexProgram, "view");
         projectionLocation = glGetUniformLocation(vertexProgram, "projection");
         colorLocation = glGetUniformLocation(vertexProgram, "color");
+        cameraPosLocation = glGetUniformLocation(vertexProgram, "cameraPos");
+        zoomFactorLocation = glGetUniformLocation(vertexProgram, "zoomFactor");
 
         orthoLocation = glGetUniformLocation(billboardProgram, "ortho");
         billboardSizeLocation = glGetUniformLocation(billboardProgram, "billboardSize");
-        screenPositionLocation = glGetUniformLocation(billboardProgram, "screenPosition");
-        bColorLocation = glGetUniformLocation(billboardProgram, "color");
+        bViewLocation = glGetUniformLocation(billboardProgram, "view");
+        bProjectionLocation = glGetUniformLocation(billboardProgram, "projection");
+        bCameraPosLocation = glGetUniformLocation(billboardProgram, "cameraPos");
+        bZoomFactorLocation = glGetUniformLocation(billboardProgram, "zoomFactor");
+        bScreenSizeLocation = glGetUniformLocation(billboardProgram, "screenSize");
+
+        instancedViewLocation = glGetUniformLocation(instancedProgram, "view");
+        instancedProjectionLocation = glGetUniformLocation(instancedProgram, "projection");
+        instancedCameraPosLocation = glGetUniformLocation(instancedProgram, "cameraPos");
+        instancedZoomFactorLocation = glGetUniformLocation(instancedProgram, "zoomFactor");
 
         aspect_ratio = aspect;
     }
@@ -111,19 +142,36 @@ public:
         glUseProgram(vertexProgram);
     }
 
-    void use_vertex(glm::mat4 model, glm::mat4 view, glm::mat4 projection, glm::vec3 color) {
+    void use_vertex(glm::mat4 model, glm::mat4 view, glm::mat4 projection, glm::vec3 color, glm::vec3 cameraPos, float zoomFactor) {
         glUseProgram(vertexProgram);
         glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(model));
         glUniformMatrix4fv(viewLocation, 1, GL_FALSE, glm::value_ptr(view));
         glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, glm::value_ptr(projection));
         glUniform3fv(colorLocation, 1, glm::value_ptr(color));
+        glUniform3fv(cameraPosLocation, 1, glm::value_ptr(cameraPos));
+        glUniform1f(zoomFactorLocation, zoomFactor);
     }
 
-    void use_billboard(glm::mat4 ortho, glm::mat4 screenPosition, glm::vec3 bColor) {
+    /**
+     * Binds billboard.glsl and sets its uniforms, positions and colors come from the instance attributes
+     */
+    void use_billboard(glm::mat4 ortho, glm::mat4 view, glm::mat4 projection, glm::vec3 cameraPos, float zoomFactor, glm::vec2 screenSize, float billboardSize) {
         glUseProgram(billboardProgram);
         glUniformMatrix4fv(orthoLocation, 1, GL_FALSE, glm::value_ptr(ortho));
-        glUniformMatrix4fv(screenPositionLocation, 1, GL_FALSE, glm::value_ptr(screenPosition));
-        glUniform3fv(bColorLocation, 1, glm::value_ptr(bColor));
+        glUniformMatrix4fv(bViewLocation, 1, GL_FALSE, glm::value_ptr(view));
+        glUniformMatrix4fv(bProjectionLocation, 1, GL_FALSE, glm::value_ptr(projection));
+        glUniform3fv(bCameraPosLocation, 1, glm::value_ptr(cameraPos));
+        glUniform1f(bZoomFactorLocation, zoomFactor);
+        glUniform2fv(bScreenSizeLocation, 1, glm::value_ptr(screenSize));
+        glUniform1f(billboardSizeLocation, billboardSize);
+    }
+
+    void use_instanced(glm::mat4 view, glm::mat4 projection, glm::vec3 cameraPos, float zoomFactor) {
+        glUseProgram(instancedProgram);
+        glUniformMatrix4fv(instancedViewLocation, 1, GL_FALSE, glm::value_ptr(view));
+        glUniformMatrix4fv(instancedProjectionLocation, 1, GL_FALSE, glm::value_ptr(projection));
+        glUniform3fv(instancedCameraPosLocation, 1, glm::value_ptr(cameraPos));
+        glUniform1f(instancedZoomFactorLocation, zoomFactor);
     }
 
     // Shader Uniform Setters
@@ -139,9 +187,6 @@ public:
     void set_ortho(glm::mat4 ortho) {
         glUniformMatrix4fv(orthoLocation, 1, GL_FALSE, glm::value_ptr(ortho));
     }
-    void set_screen_position(glm::mat4 screenPosition) {
-        glUniformMatrix4fv(screenPositionLocation, 1, GL_FALSE, glm::value_ptr(screenPosition));
-    }
 
 
     private:
@@ -0,0 +1,82 @@
+/*
+ * Unit sphere and billboard fan geometry shared by every body.
+ * Bodies are scaled and translated onto these meshes at draw time, so each mesh is generated and uploaded once
+ * no matter how many bodies are in the simulation. SphereMeshCache keeps one uploaded sphere per segment count,
+ * which the renderer uses as its levels of detail.
+ */
+
+#ifndef OPENGLPRACTICE_SPHEREMESH_H
+#define OPENGLPRACTICE_SPHEREMESH_H
+
+#include <vector>
+#include <cmath>
+
+class SphereMesh {
+    public:
+        std::vector<float> NDC_coordinates;
+        std::vector<int> NDC_indices;
+
+        /**
+         * @param segments Rings of latitude and of longitude, the sphere has 2 * segments^2 triangles
+         */
+        SphereMesh(int segments) {
+            genNDCCoordinates(segments);
+        }
+
+        /**
+         * Unit circle as a triangle fan around the origin, closed by repeating the first rim point
+         */
+        static std::vector<float> billboardCoordinates(int segments) {
+            std::vector<float> coordinates;
+            coordinates.push_back(0.0f);
+            coordinates.push_back(0.0f);
+            for (int i = 0; i < segments; i++) {
+                float sinCoord = sin(2 * M_PI * i / segments);
+                float cosCoord = cos(2 * M_PI * i / segments);
+
+                coordinates.push_back(sinCoord);
+                coordinates.push_back(cosCoord);
+            }
+            coordinates.push_back(coordinates[2]);
+            coordinates.push_back(coordinates[3]);
+            return coordinates;
+        }
+
+    private:
+        void genNDCCoordinates(int segments) {
+            // Latitude runs pole to pole, longitude all the way around with the seam column repeated
+            for (float i = 0; i <= segments; i++) {
+                float phi = M_PI * i / segments;
+                for (float j = 0; j <= segments; j++) {
+                    float theta = 2.0f * M_PI * j / segments;
+
+                    float x = sin(phi) * cos(theta);
+                    float y = cos(phi);
+                    float z = sin(phi) * sin(theta);
+
+                    NDC_coordinates.push_back(x);
+                    NDC_coordinates.push_back(y);
+                    NDC_coordinates.push_back(z);
+                }
+            }
+
+            for (int i = 0; i < segments; i++) {
+                for (int j = 0; j < segments; j++) {
+                    int a = i * (segments + 1) + j;
+                    int b = a + 1;
+                    int c = a + (segments + 1);
+                    int d = c + 1;
+
+                    NDC_indices.push_back(a);
+                    NDC_indices.push_back(c);
+                    NDC_indices.push_back(b);
+
+                    NDC_indices.push_back(b);
+                    NDC_indices.push_back(c);
+                    NDC_indices.push_back(d);
+                }
+            }
+        }
+};
+
+#endif //OPENGLPRACTICE_SPHEREMESH_H
@@ -0,0 +1,88 @@
+/*
+ * Uploaded unit spheres keyed by segment count, each generated and sent to the GPU the first time it is asked for.
+ * Every mesh gets its own VAO with the vertex positions at attribute 0 and the index buffer bound;
+ * the renderer adds the per instance attributes before each draw.
+ */
+
+#ifndef OPENGLPRACTICE_SPHEREMESHCACHE_H
+#define OPENGLPRACTICE_SPHEREMESHCACHE_H
+
+#include <glad/glad.h>
+
+#include <unordered_map>
+#include <cstddef>
+
+#include "Graphics/SphereMesh.h"
+
+struct GpuMesh {
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+    GLsizei indexCount = 0;
+    size_t bytes = 0;       // Vertex plus index buffer size
+};
+
+class SphereMeshCache {
+    public:
+        SphereMeshCache() = default;
+
+        // GL handles are owned by the cache, release() frees them while the context is still current
+        SphereMeshCache(const SphereMeshCache&) = delete;
+        SphereMeshCache& operator=(const SphereMeshCache&) = delete;
+
+        const GpuMesh& get(int segments) {
+            auto found = meshes.find(segments);
+            if (found != meshes.end()) return found->second;
+            return meshes.emplace(segments, upload(SphereMesh(segments))).first->second;
+        }
+
+        size_t size() const {
+            return meshes.size();
+        }
+
+        /**
+         * GPU memory held by every cached mesh
+         */
+        size_t bytes() const {
+            size_t total = 0;
+            for (const auto& [segments, mesh] : meshes) total += mesh.bytes;
+            return total;
+        }
+
+        void release() {
+            for (auto& [segments, mesh] : meshes) {
+                glDeleteBuffers(1, &mesh.VBO);
+                glDeleteBuffers(1, &mesh.EBO);
+                glDeleteVertexArrays(1, &mesh.VAO);
+            }
+            meshes.clear();
+        }
+
+    private:
+        std::unordered_map<int, GpuMesh> meshes;
+
+        static GpuMesh upload(const SphereMesh& sphere) {
+            GpuMesh mesh;
+            glGenVertexArrays(1, &mesh.VAO);
+            glGenBuffers(1, &mesh.VBO);
+            glGenBuffers(1, &mesh.EBO);
+
+            glBindVertexArray(mesh.VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+            glBufferData(GL_ARRAY_BUFFER, sphere.NDC_coordinates.size() * sizeof(float), sphere.NDC_coordinates.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphere.NDC_indices.size() * sizeof(int), sphere.NDC_indices.data(), GL_STATIC_DRAW);
+
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            mesh.indexCount = static_cast<GLsizei>(sphere.NDC_indices.size());
+            mesh.bytes = sphere.NDC_coordinates.size() * sizeof(float) + sphere.NDC_indices.size() * sizeof(int);
+            return mesh;
+        }
+};
+
+#endif //OPENGLPRACTICE_SPHEREMESHCACHE_H
@@ -0,0 +1,339 @@
+/*
+ * Binary checkpoint and restart of a Simulation.
+ * A file is a fixed size header followed by one contiguous section per BodyStore array, each starting on a 64 byte boundary,
+ * so the sections can be read straight into the arrays (or memory-mapped) without any parsing.
+ * Besides the bodies and their ids it stores the clock, the force, integrator and collision settings and any accelerations
+ * or other state the integrator carries between steps, which makes a restored run continue bit for bit where the saved one stopped.
+ * The one exception is a Barnes-Hut run with treeRebuildInterval > 1: the octree is rebuilt on restore instead of refit.
+ */
+
+#ifndef OPENGLPRACTICE_CHECKPOINT_H
+#define OPENGLPRACTICE_CHECKPOINT_H
+
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+    #include <io.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include "World/Simulation.h"
+
+/**
+ * On disk header, every field has a fixed width and the layout has no padding
+ */
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;         // Written as byteOrderMark, reads back differently on a machine of the other endianness
+    uint64_t bodyCount;
+    uint64_t steps;
+    double time;
+    double dt;
+    double G;
+    double softening;
+    float theta;
+    int32_t forceMethod;
+    int32_t integrator;
+    int32_t treeRebuildInterval;
+    uint32_t flags;
+    uint32_t nextId;               // BodyStore::nextFreeId(), so bodies added after a restart don't reuse a merged body's id
+    uint64_t integratorStateCount; // Doubles in the IntegratorState section
+    uint64_t collisionCount;
+    double restitution;
+    int32_t collisionResponse;
+    uint32_t reserved;
+    uint64_t sectionOffsets[16];   // Byte offset of every section, 0 when absent
+};
+
+static_assert(std::is_trivially_copyable_v<CheckpointHeader>);
+static_assert(sizeof(CheckpointHeader) == 248, "CheckpointHeader must not contain padding");
+
+class Checkpoint {
+    public:
+        static constexpr char magic[8] = { 'O', 'G', 'P', 'C', 'K', 'P', 'T', '\0' };
+        static constexpr uint32_t version = 3;
+        static constexpr uint32_t byteOrderMark = 0x01020304;
+        static constexpr uint64_t alignment = 64;
+
+        // Header flags
+        static constexpr uint32_t hasColors = 1u << 0;
+        static constexpr uint32_t hasCarriedAccelerations = 1u << 1;
+
+        // Section order, BodyStore arrays first
+        enum Section {
+            X, Y, Z, VX, VY, VZ, Mass, Radius,
+            Color,
+            AccX, AccY, AccZ,
+            IntegratorState,
+            Ids,
+            SectionCount
+        };
+
+        /**
+         * Writes sim to path. The data goes to path.tmp first, is flushed to the disk and only then moved over path
+         * in a single replacing rename, so a job killed at any point leaves either the previous or the new checkpoint
+         */
+        static void write(const Simulation& sim, const std::string& path) {
+            const BodyStore& bodies = sim.bodies;
+            uint64_t count = bodies.size();
+            const Accelerations* carried = sim.integrator->carriedAccelerations();
+            std::vector<double> integratorState = sim.integrator->carriedState();
+            bool colors = sim.render.size() == count;
+
+            CheckpointHeader header{};
+            std::memcpy(header.magic, magic, sizeof(magic));
+            header.version = version;
+            header.byteOrder = byteOrderMark;
+            header.bodyCount = count;
+            header.steps = sim.steps;
+            header.time = sim.time;
+            header.dt = sim.dt;
+            header.G = sim.G;
+            header.softening = sim.softening;
+            header.theta = sim.theta;
+            header.forceMethod = static_cast<int32_t>(sim.forceMethod);
+            header.integrator = static_cast<int32_t>(sim.integrator->type());
+            header.treeRebuildInterval = sim.treeRebuildInterval;
+            header.flags = (colors ? hasColors : 0) | (carried ? hasCarriedAccelerations : 0);
+            header.nextId = bodies.nextFreeId();
+            header.integratorStateCount = integratorState.size();
+            header.collisionCount = sim.collisionCount;
+            header.restitution = sim.collisions.restitution;
+            header.collisionResponse = static_cast<int32_t>(sim.collisions.response);
+
+            // Body sections are always written, even empty, the others only when the flags or counts say they exist
+            bool present[SectionCount] = {};
+            for (int s = 0; s < SectionCount; s++) {
+                present[s] = sectionPresent(header, s);
+            }
+            const void* sections[SectionCount] = {
+                bodies.x.data(), bodies.y.data(), bodies.z.data(),
+                bodies.vx.data(), bodies.vy.data(), bodies.vz.data(),
+                bodies.mass.data(), bodies.radius.data(),
+                colors ? sim.render.colors.data() : nullptr,
+                carried ? carried->x.data() : nullptr, carried ? carried->y.data() : nullptr, carried ? carried->z.data() : nullptr,
+                integratorState.empty() ? nullptr : integratorState.data(),
+                bodies.ids.data(),
+            };
+            uint64_t offset = alignUp(sizeof(CheckpointHeader));
+            for (int s = 0; s < SectionCount; s++) {
+                if (!present[s]) continue;
+                header.sectionOffsets[s] = offset;
+                offset = alignUp(offset + sectionBytes(header, s));
+            }
+
+            std::string temporary = path + ".tmp";
+            std::FILE* out = std::fopen(temporary.c_str(), "wb");
+            if (!out) {
+                throw std::runtime_error("Failed to open " + temporary + " for writing");
+            }
+            bool written = std::fwrite(&header, sizeof(header), 1, out) == 1;
+            uint64_t position = sizeof(header);
+            static const char padding[alignment] = {};
+            for (int s = 0; s < SectionCount && written; s++) {
+                if (!present[s]) continue;
+                size_t gap = header.sectionOffsets[s] - position;
+                size_t bytes = sectionBytes(header, s);
+                written = std::fwrite(padding, 1, gap, out) == gap && (bytes == 0 || std::fwrite(sections[s], 1, bytes, out) == bytes);
+                position = header.sectionOffsets[s] + bytes;
+            }
+            // Everything has to be on the disk before the rename can make it the checkpoint
+            written = written && std::fflush(out) == 0 && syncFile(out);
+            written = std::fclose(out) == 0 && written;
+            if (!written) {
+                std::remove(temporary.c_str());
+                throw std::runtime_error("Failed writing " + temporary);
+            }
+            if (!replaceFile(temporary, path)) {
+                throw std::runtime_error("Failed to move " + temporary + " to " + path);
+            }
+        }
+
+        /**
+         * Replaces the bodies, clock and settings of sim with the checkpoint at path
+         * Render colors are restored when the file has them, bodies get white otherwise
+         * The whole file is checked and read before sim is touched, so a bad file throws and leaves sim as it was
+         */
+        static void read(Simulation& sim, const std::string& path) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                throw std::runtime_error("Failed to open " + path);
+            }
+            in.seekg(0, std::ios::end);
+            uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+            in.seekg(0);
+
+            CheckpointHeader header;
+            in.read(reinterpret_cast<char*>(&header), sizeof(header));
+            if (!in || std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+                throw std::runtime_error(path + " is not a checkpoint");
+            }
+            if (header.byteOrder != byteOrderMark) {
+                throw std::runtime_error(path + " was written on a machine of different endianness");
+            }
+            if (header.version != version) {
+                throw std::runtime_error(path + " has checkpoint version " + std::to_string(header.version)
+                                         + ", expected " + std::to_string(version));
+            }
+            if (header.forceMethod < 0 || header.forceMethod > static_cast<int32_t>(ForceMethod::BarnesHut)) {
+                throw std::runtime_error(path + " has unknown force method " + std::to_string(header.forceMethod));
+            }
+            if (header.integrator < 0 || header.integrator > static_cast<int32_t>(IntegratorType::RKF78)) {
+                throw std::runtime_error(path + " has unknown integrator " + std::to_string(header.integrator));
+            }
+            if (header.collisionResponse < 0 || header.collisionResponse > static_cast<int32_t>(CollisionResponse::Bounce)) {
+                throw std::runtime_error(path + " has unknown collision response " + std::to_string(header.collisionResponse));
+            }
+            // Every body takes more than a byte and every state value eight, larger counts can only be corrupt
+            // and would overflow the section sizes below
+            if (header.bodyCount > fileSize || header.integratorStateCount > fileSize) {
+                throw std::runtime_error(path + " is truncated");
+            }
+            for (int s = 0; s < SectionCount; s++) {
+                if (!sectionPresent(header, s)) continue;
+                uint64_t bytes = sectionBytes(header, s);
+                if (header.sectionOffsets[s] == 0) {
+                    throw std::runtime_error(path + " is missing section " + std::to_string(s));
+                }
+                if (header.sectionOffsets[s] < sizeof(header) || header.sectionOffsets[s] > fileSize || bytes > fileSize - header.sectionOffsets[s]) {
+                    throw std::runtime_error(path + " is truncated");
+                }
+            }
+
+            size_t count = header.bodyCount;
+            BodyStore bodies;
+            std::vector<double>* arrays[8] = { &bodies.x, &bodies.y, &bodies.z, &bodies.vx, &bodies.vy, &bodies.vz, &bodies.mass, &bodies.radius };
+            for (int s = X; s <= Radius; s++) {
+                arrays[s]->resize(count);
+                readSection(in, header, s, arrays[s]->data(), path);
+            }
+            std::vector<uint32_t> ids(count);
+            readSection(in, header, Ids, ids.data(), path);
+            bodies.restoreIds(ids, header.nextId);
+
+            std::vector<glm::vec3> colors(count, glm::vec3(1.0f));
+            if (header.flags & hasColors) {
+                readSection(in, header, Color, colors.data(), path);
+            }
+            Accelerations carried;
+            if (header.flags & hasCarriedAccelerations) {
+                carried.resize(count);
+                readSection(in, header, AccX, carried.x.data(), path);
+                readSection(in, header, AccY, carried.y.data(), path);
+                readSection(in, header, AccZ, carried.z.data(), path);
+            }
+            std::vector<double> state(header.integratorStateCount);
+            if (!state.empty()) {
+                readSection(in, header, IntegratorState, state.data(), path);
+            }
+
+            // Everything is in memory, nothing below can fail on a bad file
+            sim.bodies = std::move(bodies);
+            sim.topology++;
+            sim.render.clear();
+            sim.render.reserve(count);
+            sim.render.topology = sim.topology;
+            for (size_t i = 0; i < count; i++) {
+                sim.render.add(colors[i], sim.bodies.ids[i]);
+            }
+
+            sim.steps = header.steps;
+            sim.time = header.time;
+            sim.dt = header.dt;
+            sim.G = header.G;
+            sim.softening = header.softening;
+            sim.theta = header.theta;
+            sim.forceMethod = static_cast<ForceMethod>(header.forceMethod);
+            sim.treeRebuildInterval = header.treeRebuildInterval;
+            sim.collisionCount = header.collisionCount;
+            sim.collisions.restitution = header.restitution;
+            sim.collisions.response = static_cast<CollisionResponse>(header.collisionResponse);
+            sim.setIntegrator(static_cast<IntegratorType>(header.integrator));
+            sim.invalidateTree();
+
+            if (header.flags & hasCarriedAccelerations) {
+                sim.integrator->restoreCarriedAccelerations(carried);
+            }
+            if (!state.empty()) {
+                sim.integrator->restoreCarriedState(state);
+            }
+        }
+
+    private:
+        static uint64_t alignUp(uint64_t offset) {
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+
+        /**
+         * Whether a file with this header has the section, body arrays and ids always do, even with no bodies
+         */
+        static bool sectionPresent(const CheckpointHeader& header, int section) {
+            if (section == Color) return header.flags & hasColors;
+            if (section == AccX || section == AccY || section == AccZ) return header.flags & hasCarriedAccelerations;
+            if (section == IntegratorState) return header.integratorStateCount > 0;
+            return true;
+        }
+
+        static uint64_t sectionBytes(const CheckpointHeader& header, int section) {
+            if (section == Color) return header.bodyCount * sizeof(glm::vec3);
+            if (section == IntegratorState) return header.integratorStateCount * sizeof(double);
+            if (section == Ids) return header.bodyCount * sizeof(uint32_t);
+            return header.bodyCount * sizeof(double);
+        }
+
+        /**
+         * Flushes the operating system's buffers of a file to the disk
+         */
+        static bool syncFile(std::FILE* file) {
+#ifdef _WIN32
+            return _commit(_fileno(file)) == 0;
+#else
+            return fsync(fileno(file)) == 0;
+#endif
+        }
+
+        /**
+         * Moves source over destination in one step, destination is never missing in between
+         */
+        static bool replaceFile(const std::string& source, const std::string& destination) {
+#ifdef _WIN32
+            return MoveFileExA(source.c_str(), destination.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+            if (std::rename(source.c_str(), destination.c_str()) != 0) return false;
+            // The rename itself lives in the directory, sync it too so it survives a power loss
+            size_t slash = destination.find_last_of('/');
+            std::string directory = slash == std::string::npos ? "." : destination.substr(0, slash + 1);
+            int descriptor = ::open(directory.c_str(), O_RDONLY);
+            if (descriptor >= 0) {
+                fsync(descriptor);
+                ::close(descriptor);
+            }
+            return true;
+#endif
+        }
+
+        static void readSection(std::ifstream& in, const CheckpointHeader& header, int section, void* destination, const std::string& path) {
+            if (header.sectionOffsets[section] == 0) {
+                throw std::runtime_error(path + " is missing section " + std::to_string(section));
+            }
+            in.seekg(header.sectionOffsets[section]);
+            in.read(static_cast<char*>(destination), sectionBytes(header, section));
+            if (!in) {
+                throw std::runtime_error(path + " is truncated");
+            }
+        }
+};
+
+#endif //OPENGLPRACTICE_CHECKPOINT_H
@@ -0,0 +1,236 @@
+/*
+ * Random access reader for ephemeris caches built by EphemerisImporter.
+ * The file is memory-mapped and nothing is decoded up front, so opening even a kernel sized cache is instant.
+ * state() finds the body with a binary search over the sorted ids, the segment covering the epoch with a binary search
+ * over the body's segments and the record with a binary search over the segment's records, then evaluates either a
+ * cubic Hermite curve between two samples (as in TrajectoryReader) or a Chebyshev series and its derivative.
+ * States relative to another body are chained through that body's own state until they reach the solar system barycenter.
+ */
+
+#ifndef OPENGLPRACTICE_EPHEMERISCACHE_H
+#define OPENGLPRACTICE_EPHEMERISCACHE_H
+
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+
+#include "IO/MappedFile.h"
+#include "IO/EphemerisFormat.h"
+
+class EphemerisCache {
+    public:
+        // Deepest chain of centers followed, e.g. Moon -> Earth-Moon barycenter -> solar system barycenter is 2
+        static constexpr int maxCenterDepth = 8;
+
+        EphemerisCache(const std::string& path) : file(path) {
+            if (file.size() < sizeof(EphemerisHeader)) {
+                throw std::runtime_error(path + " is not an ephemeris cache");
+            }
+            std::memcpy(&header, file.data(), sizeof(header));
+            if (std::memcmp(header.magic, EphemerisFormat::magic, sizeof(header.magic)) != 0) {
+                throw std::runtime_error(path + " is not an ephemeris cache");
+            }
+            if (header.byteOrder != EphemerisFormat::byteOrderMark || header.version != EphemerisFormat::version) {
+                throw std::runtime_error(path + " has an unsupported ephemeris version or byte order");
+            }
+            if (header.bodiesOffset % 8 != 0 || header.segmentsOffset % 8 != 0 || header.dataOffset % 8 != 0
+                || header.bodiesOffset + uint64_t(header.bodyCount) * sizeof(EphemerisBody) > file.size()
+                || header.segmentsOffset + uint64_t(header.segmentCount) * sizeof(EphemerisSegment) > file.size()
+                || header.dataOffset > file.size()) {
+                throw std::runtime_error(path + " is truncated");
+            }
+            bodies = reinterpret_cast<const EphemerisBody*>(file.data() + header.bodiesOffset);
+            segments = reinterpret_cast<const EphemerisSegment*>(file.data() + header.segmentsOffset);
+
+            for (uint32_t b = 0; b < header.bodyCount; b++) {
+                const EphemerisBody& body = bodies[b];
+                if ((b > 0 && bodies[b - 1].id >= body.id) || uint64_t(body.firstSegment) + body.segmentCount > header.segmentCount
+                    || header.namesOffset + body.nameOffset + body.nameLength > header.dataOffset) {
+                    throw std::runtime_error(path + " has a corrupt body directory");
+                }
+            }
+            for (uint32_t s = 0; s < header.segmentCount; s++) {
+                const EphemerisSegment& segment = segments[s];
+                bool known = segment.kind == EphemerisFormat::Samples || (segment.kind == EphemerisFormat::Chebyshev && segment.coefficients > 0);
+                if (!known || segment.recordCount == 0 || segment.dataOffset < header.dataOffset || segment.dataOffset % 8 != 0
+                    || segment.dataOffset + segment.recordCount * EphemerisFormat::recordDoubles(segment) * sizeof(double) > file.size()) {
+                    throw std::runtime_error(path + " has a corrupt segment directory");
+                }
+            }
+        }
+
+        size_t bodyCount() const {
+            return header.bodyCount;
+        }
+
+        /**
+         * Bodies in id order
+         */
+        const EphemerisBody& body(size_t index) const {
+            return bodies[index];
+        }
+
+        /**
+         * The body with a NAIF id, nullptr if the cache doesn't have it
+         */
+        const EphemerisBody* find(int32_t id) const {
+            const EphemerisBody* end = bodies + header.bodyCount;
+            const EphemerisBody* it = std::lower_bound(bodies, end, id, [](const EphemerisBody& body, int32_t key) {
+                return body.id < key;
+            });
+            return it != end && it->id == id ? it : nullptr;
+        }
+
+        std::string name(const EphemerisBody& body) const {
+            return std::string(reinterpret_cast<const char*>(file.data() + header.namesOffset + body.nameOffset), body.nameLength);
+        }
+
+        /**
+         * Earliest and latest epoch any segment of body covers, there may be gaps in between
+         */
+        double startTime(const EphemerisBody& body) const {
+            double time = segments[body.firstSegment].startTime;
+            for (uint32_t s = 1; s < body.segmentCount; s++) time = std::min(time, segments[body.firstSegment + s].startTime);
+            return time;
+        }
+
+        double endTime(const EphemerisBody& body) const {
+            double time = segments[body.firstSegment].endTime;
+            for (uint32_t s = 1; s < body.segmentCount; s++) time = std::max(time, segments[body.firstSegment + s].endTime);
+            return time;
+        }
+
+        /**
+         * Barycentric position and velocity of a body in meters and meters per second, ecliptic J2000
+         * @param time TDB seconds past J2000
+         * @return false when the body or one of the centers it is given relative to isn't covered at time
+         */
+        bool state(int32_t id, double time, glm::dvec3& position, glm::dvec3& velocity) const {
+            position = glm::dvec3(0.0);
+            velocity = glm::dvec3(0.0);
+            for (int depth = 0; id != 0; depth++) {
+                const EphemerisBody* body = find(id);
+                const EphemerisSegment* segment = body ? segmentAt(*body, time) : nullptr;
+                if (!segment || depth >= maxCenterDepth) return false;
+                glm::dvec3 p, v;
+                evaluate(*segment, time, p, v);
+                position += p;
+                velocity += v;
+                id = segment->center;
+            }
+            return true;
+        }
+
+        /**
+         * Whether state() can answer for the body at time
+         */
+        bool covers(int32_t id, double time) const {
+            glm::dvec3 position, velocity;
+            return state(id, time, position, velocity);
+        }
+
+    private:
+        MappedFile file;
+        EphemerisHeader header;
+        const EphemerisBody* bodies = nullptr;
+        const EphemerisSegment* segments = nullptr;
+
+        /**
+         * The segment covering time, preferring the one that starts last when segments overlap
+         */
+        const EphemerisSegment* segmentAt(const EphemerisBody& body, double time) const {
+            const EphemerisSegment* first = segments + body.firstSegment;
+            const EphemerisSegment* last = first + body.segmentCount;
+            const EphemerisSegment* it = std::upper_bound(first, last, time, [](double t, const EphemerisSegment& segment) {
+                return t < segment.startTime;
+            });
+            // Segments are sorted by start only, so a long earlier one may still reach past a short later one
+            while (it != first) {
+                --it;
+                if (time <= it->endTime) return it;
+            }
+            return nullptr;
+        }
+
+        const double* records(const EphemerisSegment& segment) const {
+            return reinterpret_cast<const double*>(file.data() + segment.dataOffset);
+        }
+
+        /**
+         * Last record whose first value is at or before key, 0 if none is
+         */
+        static uint64_t recordAt(const double* data, uint64_t count, uint64_t stride, double key) {
+            uint64_t low = 0, high = count;
+            while (high - low > 1) {
+                uint64_t middle = low + (high - low) / 2;
+                if (data[middle * stride] <= key) low = middle;
+                else high = middle;
+            }
+            return low;
+        }
+
+        void evaluate(const EphemerisSegment& segment, double time, glm::dvec3& position, glm::dvec3& velocity) const {
+            const double* data = records(segment);
+            if (segment.kind == EphemerisFormat::Samples) {
+                uint64_t r = segment.recordCount > 1 ? std::min(recordAt(data, segment.recordCount, 7, time), segment.recordCount - 2) : 0;
+                const double* a = data + r * 7;
+                const double* b = segment.recordCount > 1 ? a + 7 : a;
+                glm::dvec3 p0(a[1], a[2], a[3]), v0(a[4], a[5], a[6]), p1(b[1], b[2], b[3]), v1(b[4], b[5], b[6]);
+                double h = b[0] - a[0];
+                if (h <= 0.0) {
+                    position = p0;
+                    velocity = v0;
+                    return;
+                }
+                double s = (time - a[0]) / h;
+                // Cubic Hermite basis and its derivative
+                double h00 = (1.0 + 2.0 * s) * (1.0 - s) * (1.0 - s), h10 = s * (1.0 - s) * (1.0 - s);
+                double h01 = s * s * (3.0 - 2.0 * s), h11 = s * s * (s - 1.0);
+                double d00 = 6.0 * s * s - 6.0 * s, d10 = 3.0 * s * s - 4.0 * s + 1.0;
+                double d01 = -d00, d11 = 3.0 * s * s - 2.0 * s;
+                position = h00 * p0 + h10 * h * v0 + h01 * p1 + h11 * h * v1;
+                velocity = (d00 * p0 + d01 * p1) / h + d10 * v0 + d11 * v1;
+                return;
+            }
+
+            // Chebyshev record: midpoint, half span, then the coefficients of x, y and z
+            uint32_t n = segment.coefficients;
+            uint64_t stride = 2 + 3 * uint64_t(n);
+            // Records tile the segment, so the one starting last at or before time is the one holding it
+            uint64_t low = 0, high = segment.recordCount;
+            while (high - low > 1) {
+                uint64_t middle = low + (high - low) / 2;
+                const double* record = data + middle * stride;
+                if (record[0] - record[1] <= time) low = middle;
+                else high = middle;
+            }
+            const double* record = data + low * stride;
+            double radius = record[1];
+            double s = radius > 0.0 ? std::clamp((time - record[0]) / radius, -1.0, 1.0) : 0.0;
+            const double* coefficients[3] = { record + 2, record + 2 + n, record + 2 + 2 * n };
+            // T_k(s) and dT_k/ds by their recurrences
+            double t0 = 1.0, t1 = s, d0 = 0.0, d1 = 1.0;
+            for (int c = 0; c < 3; c++) {
+                position[c] = coefficients[c][0];
+                velocity[c] = 0.0;
+            }
+            for (uint32_t k = 1; k < n; k++) {
+                for (int c = 0; c < 3; c++) {
+                    position[c] += coefficients[c][k] * t1;
+                    velocity[c] += coefficients[c][k] * d1;
+                }
+                double t2 = 2.0 * s * t1 - t0;
+                double d2 = 2.0 * t1 + 2.0 * s * d1 - d0;
+                t0 = t1;
+                t1 = t2;
+                d0 = d1;
+                d1 = d2;
+            }
+            velocity /= radius > 0.0 ? radius : 1.0;
+        }
+};
+
+#endif //OPENGLPRACTICE_EPHEMERISCACHE_H
@@ -0,0 +1,145 @@
+/*
+ * On disk layout of the ephemeris cache shared by EphemerisImporter and EphemerisCache.
+ *
+ * [EphemerisHeader][EphemerisBody x B][EphemerisSegment x S][names][data]
+ *
+ * Bodies are sorted by NAIF id and own a run of segments sorted by start time. A segment covers one time span of one body
+ * relative to a center body, either as position and velocity samples (joined by cubic Hermite curves) or as Chebyshev
+ * records in the style of SPK type 2. Records inside a segment are sorted by time, so any epoch is found with two binary
+ * searches. Every state is stored in meters, meters per second and TDB seconds past J2000, in the ecliptic J2000 frame
+ * that objects.json uses. The data section starts on an 8 byte boundary and only holds doubles.
+ */
+
+#ifndef OPENGLPRACTICE_EPHEMERISFORMAT_H
+#define OPENGLPRACTICE_EPHEMERISFORMAT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+
+struct EphemerisHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t bodyCount;
+    uint32_t segmentCount;
+    uint64_t bodiesOffset;
+    uint64_t segmentsOffset;
+    uint64_t namesOffset;
+    uint64_t dataOffset;
+    uint64_t reserved;
+};
+
+struct EphemerisBody {
+    int32_t id;             // NAIF id, e.g. 399 for Earth, 0 for the solar system barycenter
+    uint32_t firstSegment;
+    uint32_t segmentCount;
+    uint32_t nameOffset;    // Relative to EphemerisHeader::namesOffset
+    uint32_t nameLength;
+    uint32_t reserved;
+    double mass;            // kg, 0 when the source didn't say
+    double radius;          // m, 0 when the source didn't say
+};
+
+struct EphemerisSegment {
+    double startTime;       // TDB seconds past J2000
+    double endTime;
+    int32_t center;         // NAIF id the states are relative to
+    uint32_t kind;          // EphemerisFormat::Samples or EphemerisFormat::Chebyshev
+    uint32_t coefficients;  // Chebyshev coefficients per component, 0 for samples
+    uint32_t reserved;
+    uint64_t recordCount;
+    uint64_t dataOffset;    // Byte offset of the first record in the file
+};
+
+static_assert(std::is_trivially_copyable_v<EphemerisHeader> && sizeof(EphemerisHeader) == 64, "EphemerisHeader must not contain padding");
+static_assert(std::is_trivially_copyable_v<EphemerisBody> && sizeof(EphemerisBody) == 40, "EphemerisBody must not contain padding");
+static_assert(std::is_trivially_copyable_v<EphemerisSegment> && sizeof(EphemerisSegment) == 48, "EphemerisSegment must not contain padding");
+
+namespace EphemerisFormat {
+    constexpr char magic[8] = { 'O', 'G', 'P', 'E', 'P', 'H', 'M', '\0' };
+    constexpr uint32_t version = 1;
+    constexpr uint32_t byteOrderMark = 0x01020304;
+
+    // Segment kinds
+    constexpr uint32_t Samples = 0;     // Records of time, x, y, z, vx, vy, vz
+    constexpr uint32_t Chebyshev = 1;   // Records of midpoint, half span, then the x, y and z coefficients
+
+    constexpr double secondsPerDay = 86400.0;
+    constexpr double julianDateJ2000 = 2451545.0;
+    // Obliquity of the ecliptic at J2000 (IAU 1976), rotates equatorial ICRF states into the ecliptic frame
+    constexpr double obliquityJ2000 = 84381.448 / 3600.0 * 3.14159265358979323846 / 180.0;
+
+    inline uint64_t recordDoubles(const EphemerisSegment& segment) {
+        return segment.kind == Samples ? 7 : 2 + 3 * uint64_t(segment.coefficients);
+    }
+
+    inline double julianDateToTime(double julianDate) {
+        return (julianDate - julianDateJ2000) * secondsPerDay;
+    }
+
+    inline double timeToJulianDate(double time) {
+        return time / secondsPerDay + julianDateJ2000;
+    }
+
+    /**
+     * Julian date of a Gregorian calendar date, hours may carry the time of day
+     */
+    inline double calendarToJulianDate(int year, int month, int day, double hours = 0.0) {
+        int a = (14 - month) / 12;
+        int y = year + 4800 - a;
+        int m = month + 12 * a - 3;
+        long dayNumber = day + (153 * m + 2) / 5 + 365L * y + y / 4 - y / 100 + y / 400 - 32045;
+        return dayNumber - 0.5 + hours / 24.0;
+    }
+
+    /**
+     * Parses an epoch given as "YYYY-MM-DD", "YYYY-MM-DD HH:MM[:SS]" (a T works as the separator too) or "JD2458849.5",
+     * calendar dates are taken as TDB
+     * @return TDB seconds past J2000
+     */
+    inline double parseEpoch(const std::string& text) {
+        if (text.rfind("JD", 0) == 0) {
+            return julianDateToTime(std::stod(text.substr(2)));
+        }
+        int year = 0, month = 0, day = 0, hour = 0, minute = 0;
+        double second = 0.0;
+        char separator = ' ';
+        int fields = std::sscanf(text.c_str(), "%d-%d-%d%c%d:%d:%lf", &year, &month, &day, &separator, &hour, &minute, &second);
+        if (fields < 3 || month < 1 || month > 12 || day < 1 || day > 31 || (fields > 3 && fields < 6)) {
+            throw std::invalid_argument("Unrecognized epoch " + text + ", expected YYYY-MM-DD[THH:MM[:SS]] or JD<julian date>");
+        }
+        return julianDateToTime(calendarToJulianDate(year, month, day, hour + minute / 60.0 + second / 3600.0));
+    }
+
+    /**
+     * "YYYY-MM-DD HH:MM:SS" of a TDB time, for reports
+     */
+    inline std::string formatEpoch(double time) {
+        double julianDate = timeToJulianDate(time) + 0.5;
+        long z = static_cast<long>(std::floor(julianDate));
+        double seconds = std::round((julianDate - z) * secondsPerDay);
+        if (seconds >= secondsPerDay) {
+            z++;
+            seconds -= secondsPerDay;
+        }
+        long alpha = static_cast<long>((z - 1867216.25) / 36524.25);
+        long a = z + 1 + alpha - alpha / 4;
+        long b = a + 1524;
+        long c = static_cast<long>((b - 122.1) / 365.25);
+        long d = static_cast<long>(365.25 * c);
+        long e = static_cast<long>((b - d) / 30.6001);
+        int day = static_cast<int>(b - d - static_cast<long>(30.6001 * e));
+        int month = static_cast<int>(e < 14 ? e - 1 : e - 13);
+        int year = static_cast<int>(month > 2 ? c - 4716 : c - 4715);
+        int s = static_cast<int>(seconds);
+        char text[32];
+        std::snprintf(text, sizeof(text), "%04d-%02d-%02d %02d:%02d:%02d", year, month, day, s / 3600, s / 60 % 60, s % 60);
+        return text;
+    }
+}
+
+#endif //OPENGLPRACTICE_EPHEMERISFORMAT_H
@@ -0,0 +1,501 @@
+/*
+ * Builds an ephemeris cache (see EphemerisFormat.h) from ephemeris files that were downloaded once and kept on disk,
+ * so scenarios can be set up at any date without asking the Horizons API again.
+ * Two kinds of input are understood:
+ *  - Horizons vector tables (EPHEM_TYPE=VECTORS) as saved from the web interface or the API, in plain text, CSV_FORMAT=YES
+ *    or the API's JSON envelope. Name, NAIF id, center, mass and radius come from the header, like objectsJSONCreator.py.
+ *  - Binary SPK kernels (e.g. de440s.bsp) in little endian IEEE format, from which every type 2 and type 3
+ *    Chebyshev segment is copied. Names, masses and radii of the major bodies come from knownBodies().
+ * Everything is converted to meters, seconds and the ecliptic J2000 frame once here, so lookups never convert anything.
+ */
+
+#ifndef OPENGLPRACTICE_EPHEMERISIMPORTER_H
+#define OPENGLPRACTICE_EPHEMERISIMPORTER_H
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <regex>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <json.hpp>
+
+#include "IO/EphemerisFormat.h"
+#include "IO/MappedFile.h"
+
+class EphemerisImporter {
+    public:
+        /**
+         * Name, mass, radius and display color of a body that is commonly found in planetary ephemerides
+         */
+        struct KnownBody {
+            int32_t id;
+            const char* name;
+            double mass;    // kg
+            double radius;  // km
+            const char* color;
+        };
+
+        static const std::vector<KnownBody>& knownBodies() {
+            // Barycenters carry the mass of their whole system and the radius of the main body
+            static const std::vector<KnownBody> bodies = {
+                { 0, "Solar System Barycenter", 0.0, 0.0, "WHITE" },
+                { 1, "Mercury Barycenter", 3.3011e23, 2439.4, "GREY" },
+                { 2, "Venus Barycenter", 4.8675e24, 6051.8, "YELLOW" },
+                { 3, "Earth-Moon Barycenter", 6.04559e24, 6371.0, "GREEN" },
+                { 4, "Mars Barycenter", 6.4171e23, 3389.5, "RED" },
+                { 5, "Jupiter Barycenter", 1.89858e27, 69911.0, "TAN" },
+                { 6, "Saturn Barycenter", 5.68477e26, 58232.0, "TAN" },
+                { 7, "Uranus Barycenter", 8.68217e25, 25362.0, "BLUE" },
+                { 8, "Neptune Barycenter", 1.02431e26, 24622.0, "BLUE" },
+                { 9, "Pluto Barycenter", 1.4616e22, 1188.3, "GREY" },
+                { 10, "Sun", 1.98841e30, 695700.0, "YELLOW" },
+                { 199, "Mercury", 3.3011e23, 2439.4, "GREY" },
+                { 299, "Venus", 4.8675e24, 6051.8, "YELLOW" },
+                { 301, "Moon", 7.342e22, 1737.4, "GREY" },
+                { 399, "Earth", 5.97217e24, 6371.0, "GREEN" },
+                { 499, "Mars", 6.4171e23, 3389.5, "RED" },
+                { 599, "Jupiter", 1.89819e27, 69911.0, "TAN" },
+                { 699, "Saturn", 5.6834e26, 58232.0, "TAN" },
+                { 799, "Uranus", 8.6813e25, 25362.0, "BLUE" },
+                { 899, "Neptune", 1.02409e26, 24622.0, "BLUE" },
+                { 999, "Pluto", 1.303e22, 1188.3, "GREY" },
+            };
+            return bodies;
+        }
+
+        static const KnownBody* knownBody(int32_t id) {
+            for (const KnownBody& body : knownBodies()) {
+                if (body.id == id) return &body;
+            }
+            return nullptr;
+        }
+
+        // Problems that didn't stop the import, e.g. skipped SPK segments of an unsupported type
+        std::vector<std::string> warnings;
+
+        /**
+         * Imports path as an SPK kernel when it starts with a DAF/SPK signature, else as a Horizons vector table
+         * @return Segments added
+         */
+        size_t addFile(const std::string& path) {
+            char signature[8] = {};
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                throw std::runtime_error("Failed to open " + path);
+            }
+            in.read(signature, sizeof(signature));
+            if (std::memcmp(signature, "DAF/SPK ", 8) == 0) {
+                in.close();
+                return addSpk(path);
+            }
+            in.seekg(0);
+            std::stringstream text;
+            text << in.rdbuf();
+            return addHorizons(text.str(), path);
+        }
+
+        /**
+         * Adds the state vectors of one Horizons VECTORS response as one sampled segment
+         * @param source Name used in error messages
+         */
+        size_t addHorizons(std::string text, const std::string& source = "Horizons table") {
+            size_t first = text.find_first_not_of(" \t\r\n");
+            if (first != std::string::npos && text[first] == '{') {
+                // The API's JSON envelope, the table itself is the "result" string
+                nlohmann::json response = nlohmann::json::parse(text);
+                if (!response.contains("result")) {
+                    throw std::runtime_error(source + " is JSON without a Horizons result");
+                }
+                text = response["result"].get<std::string>();
+            }
+
+            size_t begin = text.find("$$SOE");
+            size_t end = text.find("$$EOE");
+            if (begin == std::string::npos || end == std::string::npos || end < begin) {
+                throw std::runtime_error(source + " has no $$SOE / $$EOE state vector block");
+            }
+            std::string headerText = text.substr(0, begin);
+
+            std::smatch match;
+            if (!std::regex_search(headerText, match, std::regex(R"(Target body name:\s*(.*?)\s*\((-?[0-9]+)\))"))) {
+                throw std::runtime_error(source + " has no target body name");
+            }
+            int32_t id = std::stoi(match[2]);
+            std::string name = match[1];
+            int32_t center = 0;
+            if (std::regex_search(headerText, match, std::regex(R"(Center body name:\s*.*?\s*\((-?[0-9]+)\))"))) {
+                center = std::stoi(match[1]);
+            }
+            double mass = 0.0, radius = 0.0;
+            // Same patterns as objectsJSONCreator.py, e.g. "Mass x10^23 (kg)= 6.4171" and "Vol. Mean Radius (km) = 3389.92"
+            if (std::regex_search(headerText, match, std::regex(R"(Mass[\s,x]+10\^([0-9]+)\s*\(?kg\)?\s*=[\s~]+([0-9]+\.?[0-9]*))"))) {
+                mass = std::stod(match[2].str() + "e" + match[1].str());
+            }
+            if (std::regex_search(headerText, match, std::regex(R"(Vol\. [mM]ean [rR]adius[\s,]+\(?km\)?\s+=\s+([0-9]+\.?[0-9]*))"))) {
+                radius = std::stod(match[1]);
+            }
+
+            // Output units: KM-S unless the request said otherwise
+            double lengthScale = 1000.0, timeScale = 1.0;
+            if (headerText.find("AU-D") != std::string::npos) {
+                lengthScale = 149597870700.0;
+                timeScale = EphemerisFormat::secondsPerDay;
+            }
+            else if (headerText.find("KM-D") != std::string::npos) {
+                timeScale = EphemerisFormat::secondsPerDay;
+            }
+            // Ecliptic unless the "Reference frame" / "Reference plane" lines say otherwise
+            std::string frameLines;
+            std::regex frameLine(R"(Reference (frame|plane)\s*:[^\n]*)");
+            for (auto it = std::sregex_iterator(headerText.begin(), headerText.end(), frameLine); it != std::sregex_iterator(); ++it) {
+                frameLines += it->str();
+            }
+            if (frameLines.find("BODY") != std::string::npos) {
+                throw std::runtime_error(source + " uses a body equator frame, request ecliptic or ICRF vectors");
+            }
+            bool equatorial = !frameLines.empty() && frameLines.find("Ecliptic") == std::string::npos;
+
+            std::vector<double> records = parseVectors(text.data() + begin + 5, text.data() + end, source);
+            if (records.empty()) {
+                throw std::runtime_error(source + " contains no state vectors");
+            }
+            double jd = 0.0;
+            for (size_t r = 0; r < records.size(); r += 7) {
+                jd = records[r];
+                records[r] = EphemerisFormat::julianDateToTime(jd);
+                for (int c = 1; c < 7; c++) {
+                    records[r + c] *= c < 4 ? lengthScale : lengthScale / timeScale;
+                }
+                if (equatorial) {
+                    rotateToEcliptic(&records[r + 1]);
+                    rotateToEcliptic(&records[r + 4]);
+                }
+            }
+            sortSamples(records);
+
+            BodyData& body = bodyData(id);
+            if (!name.empty()) body.name = name;
+            if (mass > 0.0) body.mass = mass;
+            if (radius > 0.0) body.radius = radius * 1000.0;
+            SegmentData segment{ records.front(), records[records.size() - 7], center, EphemerisFormat::Samples, 0, std::move(records) };
+            body.segments.push_back(std::move(segment));
+            return 1;
+        }
+
+        /**
+         * Adds every type 2 and type 3 segment of a binary SPK kernel
+         */
+        size_t addSpk(const std::string& path) {
+            MappedFile file(path);
+            const uint8_t* data = file.data();
+            if (file.size() < 1024 || std::memcmp(data, "DAF/SPK ", 8) != 0) {
+                throw std::runtime_error(path + " is not an SPK kernel");
+            }
+            int32_t nd = readInt(data + 8), ni = readInt(data + 12), forward = readInt(data + 76);
+            // Kernels older than the format string are native order, which only little endian ones survive on this path anyway
+            if (std::memcmp(data + 88, "LTL-IEEE", 8) != 0 && std::memcmp(data + 88, "\0\0\0\0\0\0\0\0", 8) != 0) {
+                throw std::runtime_error(path + " is not a little endian IEEE kernel, convert it with NAIF's toxfr/tobin");
+            }
+            if (nd != 2 || ni != 6) {
+                throw std::runtime_error(path + " has an unexpected summary format");
+            }
+            const size_t summaryBytes = (nd + (ni + 1) / 2) * sizeof(double);
+
+            size_t added = 0;
+            for (int32_t record = forward, guard = 0; record > 0 && guard < 100000; guard++) {
+                size_t base = size_t(record - 1) * 1024;
+                if (base + 1024 > file.size()) {
+                    throw std::runtime_error(path + " has a summary record past its end");
+                }
+                int32_t next = static_cast<int32_t>(readDouble(data + base));
+                int32_t count = static_cast<int32_t>(readDouble(data + base + 16));
+                for (int32_t s = 0; s < count && 24 + (s + 1) * summaryBytes <= 1024; s++) {
+                    const uint8_t* summary = data + base + 24 + s * summaryBytes;
+                    added += addSpkSegment(file, path, readDouble(summary), readDouble(summary + 8), summary + 16);
+                }
+                record = next;
+            }
+            return added;
+        }
+
+        size_t bodyCount() const {
+            return bodies.size();
+        }
+
+        /**
+         * Writes the cache, bodies ordered by id and each body's segments by start time
+         */
+        void write(const std::string& path) {
+            if (bodies.empty()) {
+                throw std::runtime_error("Nothing to write, no ephemeris was imported");
+            }
+
+            std::string names;
+            std::vector<EphemerisBody> bodyRecords;
+            std::vector<EphemerisSegment> segmentRecords;
+            for (auto& [id, body] : bodies) {
+                std::stable_sort(body.segments.begin(), body.segments.end(), [](const SegmentData& a, const SegmentData& b) {
+                    return a.start < b.start;
+                });
+                EphemerisBody record{};
+                record.id = id;
+                record.firstSegment = static_cast<uint32_t>(segmentRecords.size());
+                record.segmentCount = static_cast<uint32_t>(body.segments.size());
+                record.nameOffset = static_cast<uint32_t>(names.size());
+                record.nameLength = static_cast<uint32_t>(body.name.size());
+                record.mass = body.mass;
+                record.radius = body.radius;
+                names += body.name;
+                bodyRecords.push_back(record);
+                for (const SegmentData& segment : body.segments) {
+                    EphemerisSegment segmentRecord{};
+                    segmentRecord.startTime = segment.start;
+                    segmentRecord.endTime = segment.end;
+                    segmentRecord.center = segment.center;
+                    segmentRecord.kind = segment.kind;
+                    segmentRecord.coefficients = segment.coefficients;
+                    segmentRecord.recordCount = segment.records.size() / EphemerisFormat::recordDoubles(segmentRecord);
+                    segmentRecords.push_back(segmentRecord);
+                }
+            }
+
+            EphemerisHeader header{};
+            std::memcpy(header.magic, EphemerisFormat::magic, sizeof(header.magic));
+            header.version = EphemerisFormat::version;
+            header.byteOrder = EphemerisFormat::byteOrderMark;
+            header.bodyCount = static_cast<uint32_t>(bodyRecords.size());
+            header.segmentCount = static_cast<uint32_t>(segmentRecords.size());
+            header.bodiesOffset = sizeof(EphemerisHeader);
+            header.segmentsOffset = header.bodiesOffset + bodyRecords.size() * sizeof(EphemerisBody);
+            header.namesOffset = header.segmentsOffset + segmentRecords.size() * sizeof(EphemerisSegment);
+            header.dataOffset = (header.namesOffset + names.size() + 7) / 8 * 8;
+
+            uint64_t offset = header.dataOffset;
+            size_t s = 0;
+            for (const auto& [id, body] : bodies) {
+                for (const SegmentData& segment : body.segments) {
+                    segmentRecords[s++].dataOffset = offset;
+                    offset += segment.records.size() * sizeof(double);
+                }
+            }
+
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                throw std::runtime_error("Failed to open " + path + " for writing");
+            }
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(bodyRecords.data()), bodyRecords.size() * sizeof(EphemerisBody));
+            out.write(reinterpret_cast<const char*>(segmentRecords.data()), segmentRecords.size() * sizeof(EphemerisSegment));
+            out.write(names.data(), names.size());
+            const char padding[8] = {};
+            out.write(padding, header.dataOffset - header.namesOffset - names.size());
+            for (const auto& [id, body] : bodies) {
+                for (const SegmentData& segment : body.segments) {
+                    out.write(reinterpret_cast<const char*>(segment.records.data()), segment.records.size() * sizeof(double));
+                }
+            }
+            if (!out) {
+                throw std::runtime_error("Failed to write " + path);
+            }
+        }
+
+    private:
+        struct SegmentData {
+            double start, end;
+            int32_t center;
+            uint32_t kind;
+            uint32_t coefficients;
+            std::vector<double> records;
+        };
+
+        struct BodyData {
+            std::string name;
+            double mass = 0.0;
+            double radius = 0.0;
+            std::vector<SegmentData> segments;
+        };
+
+        std::map<int32_t, BodyData> bodies;
+
+        static int32_t readInt(const uint8_t* at) {
+            int32_t value;
+            std::memcpy(&value, at, sizeof(value));
+            return value;
+        }
+
+        static double readDouble(const uint8_t* at) {
+            double value;
+            std::memcpy(&value, at, sizeof(value));
+            return value;
+        }
+
+        /**
+         * Rotates one equatorial (ICRF) vector into the ecliptic J2000 frame in place
+         */
+        static void rotateToEcliptic(double* v) {
+            const double c = std::cos(EphemerisFormat::obliquityJ2000), s = std::sin(EphemerisFormat::obliquityJ2000);
+            double y = c * v[1] + s * v[2];
+            double z = -s * v[1] + c * v[2];
+            v[1] = y;
+            v[2] = z;
+        }
+
+        /**
+         * New bodies start out with the known name, mass and radius, if any
+         */
+        BodyData& bodyData(int32_t id) {
+            auto [it, inserted] = bodies.try_emplace(id);
+            if (inserted) {
+                const KnownBody* known = knownBody(id);
+                it->second.name = known ? known->name : "NAIF " + std::to_string(id);
+                it->second.mass = known ? known->mass : 0.0;
+                it->second.radius = known ? known->radius * 1000.0 : 0.0;
+            }
+            return it->second;
+        }
+
+        /**
+         * Reads the records between $$SOE and $$EOE as JD, X, Y, Z, VX, VY, VZ, in either the labelled or the CSV layout
+         * Extra quantities of the larger VEC_TABLE settings (LT, RG, RR) are skipped
+         */
+        static std::vector<double> parseVectors(const char* begin, const char* end, const std::string& source) {
+            std::vector<double> records;
+            double record[7];
+            int filled = -1;
+            auto flush = [&] {
+                if (filled == 6) records.insert(records.end(), record, record + 7);
+                else if (filled >= 0) throw std::runtime_error(source + " has an incomplete state vector at JD " + std::to_string(record[0]));
+                filled = -1;
+            };
+
+            const char* line = begin;
+            while (line < end) {
+                const char* lineEnd = std::find(line, end, '\n');
+                const char* p = line;
+                while (p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+                if (p < lineEnd && (std::isdigit(static_cast<unsigned char>(*p)) || *p == '-' || *p == '.')) {
+                    flush();
+                    std::string text(p, lineEnd);
+                    record[0] = std::strtod(text.c_str(), nullptr);
+                    filled = 0;
+                    if (text.find(',') != std::string::npos) {
+                        // CSV: JDTDB, Calendar Date (TDB), X, Y, Z, VX, VY, VZ, ...
+                        std::stringstream fields(text);
+                        std::string field;
+                        for (int column = 0; std::getline(fields, field, ',') && filled < 6; column++) {
+                            if (column >= 2) record[++filled] = std::stod(field);
+                        }
+                        flush();
+                    }
+                }
+                else if (filled >= 0) {
+                    // Labelled: " X =-5.68E+05 Y = 1.11E+06 Z = 3.45E+03" then " VX=-1.44E-02 VY=..."
+                    while (p < lineEnd) {
+                        const char* label = p;
+                        while (p < lineEnd && std::isalpha(static_cast<unsigned char>(*p))) p++;
+                        if (p == label) {
+                            p++;
+                            continue;
+                        }
+                        std::string key(label, p);
+                        while (p < lineEnd && *p == ' ') p++;
+                        if (p >= lineEnd || *p != '=') continue;
+                        std::string number(p + 1, lineEnd);
+                        char* after;
+                        double value = std::strtod(number.c_str(), &after);
+                        p += 1 + (after - number.c_str());
+                        static const char* keys[6] = { "X", "Y", "Z", "VX", "VY", "VZ" };
+                        for (int k = 0; k < 6; k++) {
+                            if (key == keys[k]) {
+                                record[k + 1] = value;
+                                filled = std::max(filled, k + 1);
+                            }
+                        }
+                    }
+                }
+                line = lineEnd + 1;
+            }
+            flush();
+            return records;
+        }
+
+        /**
+         * Orders samples by time and drops repeated epochs, which would make the Hermite interval zero
+         */
+        static void sortSamples(std::vector<double>& records) {
+            size_t count = records.size() / 7;
+            std::vector<size_t> order(count);
+            for (size_t i = 0; i < count; i++) order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return records[a * 7] < records[b * 7]; });
+            std::vector<double> sorted;
+            sorted.reserve(records.size());
+            for (size_t i : order) {
+                if (!sorted.empty() && sorted[sorted.size() - 7] == records[i * 7]) continue;
+                sorted.insert(sorted.end(), records.begin() + i * 7, records.begin() + i * 7 + 7);
+            }
+            records = std::move(sorted);
+        }
+
+        /**
+         * Copies one SPK segment, given its summary integers: target, center, frame, type, first and last address
+         */
+        size_t addSpkSegment(const MappedFile& file, const std::string& path, double start, double end, const uint8_t* integers) {
+            int32_t target = readInt(integers), center = readInt(integers + 4), frame = readInt(integers + 8), type = readInt(integers + 12);
+            int64_t first = readInt(integers + 16), last = readInt(integers + 20);
+            std::string segmentName = path + " segment " + std::to_string(target) + " wrt " + std::to_string(center);
+            if (type != 2 && type != 3) {
+                warnings.push_back(segmentName + " skipped, SPK type " + std::to_string(type) + " is not supported");
+                return 0;
+            }
+            // Frame 1 is J2000 (ICRF), 17 is ECLIPJ2000
+            if (frame != 1 && frame != 17) {
+                warnings.push_back(segmentName + " skipped, frame " + std::to_string(frame) + " is not supported");
+                return 0;
+            }
+            if (first < 1 || last < first + 3 || uint64_t(last) * sizeof(double) > file.size()) {
+                throw std::runtime_error(segmentName + " lies outside the file");
+            }
+
+            // The directory at the end of the segment: INIT, INTLEN, RSIZE, N
+            const uint8_t* directory = file.data() + (last - 4) * sizeof(double);
+            uint64_t recordSize = static_cast<uint64_t>(readDouble(directory + 16));
+            uint64_t recordCount = static_cast<uint64_t>(readDouble(directory + 24));
+            int components = type == 2 ? 3 : 6;
+            if (recordSize < 2 + uint64_t(components) || (recordSize - 2) % components != 0
+                || uint64_t(first - 1) + recordSize * recordCount > uint64_t(last - 4)) {
+                throw std::runtime_error(segmentName + " has a corrupt record directory");
+            }
+            // Type 3 also stores velocity coefficients, the derivative of the position ones is used instead
+            uint32_t coefficients = static_cast<uint32_t>((recordSize - 2) / components);
+
+            SegmentData segment{ start, end, center, EphemerisFormat::Chebyshev, coefficients, {} };
+            segment.records.resize(recordCount * (2 + 3 * coefficients));
+            double* out = segment.records.data();
+            std::vector<double> raw(recordSize);
+            for (uint64_t r = 0; r < recordCount; r++) {
+                std::memcpy(raw.data(), file.data() + (first - 1 + r * recordSize) * sizeof(double), recordSize * sizeof(double));
+                out[0] = raw[0];
+                out[1] = raw[1];
+                for (uint32_t k = 0; k < coefficients; k++) {
+                    // Chebyshev series are linear in their coefficients, so scaling and rotating them is exact
+                    double v[3] = { raw[2 + k] * 1000.0, raw[2 + coefficients + k] * 1000.0, raw[2 + 2 * coefficients + k] * 1000.0 };
+                    if (frame == 1) rotateToEcliptic(v);
+                    out[2 + k] = v[0];
+                    out[2 + coefficients + k] = v[1];
+                    out[2 + 2 * coefficients + k] = v[2];
+                }
+                out += 2 + 3 * coefficients;
+            }
+            bodyData(target).segments.push_back(std::move(segment));
+            return 1;
+        }
+};
+
+#endif //OPENGLPRACTICE_EPHEMERISIMPORTER_H
@@ -0,0 +1,106 @@
+/*
+ * Read-only memory mapping of a whole file. Pages are faulted in by the OS as they are touched,
+ * so large files can be read at random without loading them into RAM first.
+ */
+
+#ifndef OPENGLPRACTICE_MAPPEDFILE_H
+#define OPENGLPRACTICE_MAPPEDFILE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+class MappedFile {
+    public:
+        MappedFile(const std::string& path) {
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE) {
+                throw std::runtime_error("Failed to open " + path);
+            }
+            LARGE_INTEGER fileSize;
+            GetFileSizeEx(file, &fileSize);
+            length = static_cast<size_t>(fileSize.QuadPart);
+            if (length > 0) {
+                mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                bytes = mapping ? static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+                if (!bytes) {
+                    close();
+                    throw std::runtime_error("Failed to map " + path);
+                }
+            }
+#else
+            descriptor = ::open(path.c_str(), O_RDONLY);
+            if (descriptor < 0) {
+                throw std::runtime_error("Failed to open " + path);
+            }
+            struct stat info;
+            fstat(descriptor, &info);
+            length = static_cast<size_t>(info.st_size);
+            if (length > 0) {
+                void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+                if (address == MAP_FAILED) {
+                    close();
+                    throw std::runtime_error("Failed to map " + path);
+                }
+                bytes = static_cast<const uint8_t*>(address);
+            }
+#endif
+        }
+
+        ~MappedFile() {
+            close();
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const uint8_t* data() const {
+            return bytes;
+        }
+
+        size_t size() const {
+            return length;
+        }
+
+    private:
+        const uint8_t* bytes = nullptr;
+        size_t length = 0;
+
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = NULL;
+
+        void close() {
+            if (bytes) UnmapViewOfFile(bytes);
+            if (mapping) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+            bytes = nullptr;
+            mapping = NULL;
+            file = INVALID_HANDLE_VALUE;
+        }
+#else
+        int descriptor = -1;
+
+        void close() {
+            if (bytes) munmap(const_cast<uint8_t*>(bytes), length);
+            if (descriptor >= 0) ::close(descriptor);
+            bytes = nullptr;
+            descriptor = -1;
+        }
+#endif
+};
+
+#endif //OPENGLPRACTICE_MAPPEDFILE_H
@@ -0,0 +1,384 @@
+/*
+ * Streaming loader for scenario files in the objects.json layout.
+ * The file is memory-mapped and fed through nlohmann's SAX interface, so no JSON DOM is ever built: every value goes
+ * straight into the body store and render table, which are reserved up front when "count" comes before "objects".
+ * The schema is checked along the way and a bad file fails with the object index and field at fault.
+ *
+ * {
+ *     "count": 2,                                          optional, must match the number of objects when given
+ *     "units": { "length": "km", "time": "s", "mass": "kg" },  optional, these are the defaults
+ *     "objects": [
+ *         { "name": "Sun", "mass": 1.98841e+30, "radius": 695700.0, "X": ..., "Y": ..., "Z": ...,
+ *           "VX": ..., "VY": ..., "VZ": ..., "color": "YELLOW" },
+ *         ...
+ *     ]
+ * }
+ *
+ * Lengths (radius and position) may be m, km or au, velocities are in length units per time unit, time may be s or day,
+ * mass may be kg or solar. name is optional, every other field is required. Unknown keys are skipped.
+ */
+
+#ifndef OPENGLPRACTICE_SCENARIOLOADER_H
+#define OPENGLPRACTICE_SCENARIOLOADER_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include <json.hpp>
+#include <glm/glm.hpp>
+
+#include "IO/MappedFile.h"
+#include "World/BodyStore.h"
+#include "World/RenderTable.h"
+#include "Graphics/Colors.h"
+
+/**
+ * What one load did, for throughput reports
+ */
+struct ScenarioLoadStats {
+    size_t bodies = 0;
+    size_t bytes = 0;
+    double seconds = 0.0;
+
+    double megabytesPerSecond() const {
+        return seconds > 0.0 ? bytes / seconds / 1e6 : 0.0;
+    }
+};
+
+class ScenarioLoader {
+    public:
+        // Used when no path is given, relative to the build directory like the other data paths
+        static inline std::string defaultPath = "../planetData/objects.json";
+
+        /**
+         * Appends every object in the file at path to bodies and render
+         * Nothing is appended when the file fails validation
+         */
+        static ScenarioLoadStats load(const std::string& path, BodyStore& bodies, RenderTable& render) {
+            auto start = std::chrono::steady_clock::now();
+            MappedFile file(path);
+            const char* text = reinterpret_cast<const char*>(file.data());
+
+            size_t first = bodies.size();
+            Handler handler(bodies, render);
+            bool parsed = false;
+            try {
+                parsed = nlohmann::json::sax_parse(text, text + file.size(), &handler);
+            }
+            catch (...) {
+                handler.rollback();
+                throw;
+            }
+            if (!parsed || !handler.finish()) {
+                handler.rollback();
+                throw std::runtime_error(path + ": " + handler.error);
+            }
+
+            ScenarioLoadStats stats;
+            stats.bodies = bodies.size() - first;
+            stats.bytes = file.size();
+            stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return stats;
+        }
+
+    private:
+        /**
+         * SAX consumer, tracks where in the document it is and writes finished objects out as it goes
+         */
+        class Handler : public nlohmann::json_sax<nlohmann::json> {
+            public:
+                std::string error;
+
+                Handler(BodyStore& bodies, RenderTable& render) : bodies(bodies), render(render), first(bodies.size()) {
+
+                }
+
+                bool null() override {
+                    return other("null");
+                }
+
+                bool boolean(bool) override {
+                    return other("a boolean");
+                }
+
+                bool binary(binary_t&) override {
+                    return other("binary data");
+                }
+
+                bool number_integer(number_integer_t number) override {
+                    return number_float(static_cast<double>(number), "");
+                }
+
+                bool number_unsigned(number_unsigned_t number) override {
+                    return number_float(static_cast<double>(number), "");
+                }
+
+                bool number_float(number_float_t number, const string_t&) override {
+                    if (skipDepth > 0) return true;
+                    if (state == State::TopLevel && currentKey == "count") {
+                        if (number < 0.0 || number != std::floor(number)) return fail("count must be a whole number");
+                        declaredCount = static_cast<size_t>(number);
+                        bodies.reserve(first + declaredCount);
+                        render.reserve(first + declaredCount);
+                        return true;
+                    }
+                    if (state != State::Object || field < 0) return other("a number");
+                    if (!std::isfinite(number)) return fail(objectName() + " has a non-finite " + fieldNames[field]);
+                    values[field] = number;
+                    seen |= 1u << field;
+                    return true;
+                }
+
+                bool string(string_t& text) override {
+                    if (skipDepth > 0) return true;
+                    if (state == State::Units) return unit(text);
+                    if (state == State::Object && currentKey == "name") {
+                        name = text;
+                        return true;
+                    }
+                    if (state == State::Object && currentKey == "color") {
+                        auto color = Colors::colors.find(text);
+                        if (color == Colors::colors.end()) return fail(objectName() + " has unknown color " + text);
+                        objectColor = color->second;
+                        seen |= colorBit;
+                        return true;
+                    }
+                    return other("a string");
+                }
+
+                bool start_object(std::size_t) override {
+                    if (skipDepth > 0) {
+                        skipDepth++;
+                        return true;
+                    }
+                    if (state == State::Document) {
+                        state = State::TopLevel;
+                        return true;
+                    }
+                    if (state == State::TopLevel && currentKey == "units") {
+                        state = State::Units;
+                        return true;
+                    }
+                    if (state == State::Objects) {
+                        state = State::Object;
+                        seen = 0;
+                        name.clear();
+                        currentKey.clear();
+                        return true;
+                    }
+                    return other("an object");
+                }
+
+                bool key(string_t& text) override {
+                    if (skipDepth > 0) return true;
+                    currentKey = text;
+                    field = -1;
+                    if (state == State::Object) {
+                        for (int f = 0; f < fieldCount; f++) {
+                            if (currentKey == fieldNames[f]) field = f;
+                        }
+                    }
+                    return true;
+                }
+
+                bool end_object() override {
+                    if (skipDepth > 0) {
+                        skipDepth--;
+                        return true;
+                    }
+                    currentKey.clear();
+                    field = -1;
+                    if (state == State::Object) {
+                        state = State::Objects;
+                        return addObject();
+                    }
+                    state = state == State::Units ? State::TopLevel : State::Done;
+                    return true;
+                }
+
+                bool start_array(std::size_t) override {
+                    if (skipDepth > 0) {
+                        skipDepth++;
+                        return true;
+                    }
+                    if (state == State::TopLevel && currentKey == "objects") {
+                        if (sawObjects) return fail("objects appears twice");
+                        sawObjects = true;
+                        state = State::Objects;
+                        return true;
+                    }
+                    return other("an array");
+                }
+
+                bool end_array() override {
+                    if (skipDepth > 0) {
+                        skipDepth--;
+                        return true;
+                    }
+                    state = State::TopLevel;
+                    currentKey.clear();
+                    return true;
+                }
+
+                bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& exception) override {
+                    return fail("malformed JSON at byte " + std::to_string(position) + " (" + exception.what() + ")");
+                }
+
+                /**
+                 * Checks what can only be checked at the end and converts the new bodies to meters, seconds and kilograms
+                 */
+                bool finish() {
+                    if (!sawObjects) return fail("there is no objects array");
+                    size_t count = bodies.size() - first;
+                    if (declaredCount != unset && declaredCount != count) {
+                        return fail("count is " + std::to_string(declaredCount) + " but there are " + std::to_string(count) + " objects");
+                    }
+                    double speed = lengthScale / timeScale;
+                    for (size_t i = first; i < bodies.size(); i++) {
+                        bodies.x[i] *= lengthScale;
+                        bodies.y[i] *= lengthScale;
+                        bodies.z[i] *= lengthScale;
+                        bodies.vx[i] *= speed;
+                        bodies.vy[i] *= speed;
+                        bodies.vz[i] *= speed;
+                        bodies.mass[i] *= massScale;
+                        bodies.radius[i] *= lengthScale;
+                    }
+                    return true;
+                }
+
+                /**
+                 * Drops everything appended by a failed load
+                 */
+                void rollback() {
+                    std::vector<uint8_t> keep(bodies.size(), 0);
+                    std::fill(keep.begin(), keep.begin() + first, 1);
+                    bodies.compact(keep);
+                    render.colors.resize(first);
+                    render.trails.erase(render.trails.begin() + std::min(first, render.trails.size()), render.trails.end());
+                    render.ids.resize(first);
+                }
+
+            private:
+                enum class State { Document, TopLevel, Units, Objects, Object, Done };
+
+                static constexpr int fieldCount = 8;
+                static constexpr const char* fieldNames[fieldCount] = { "mass", "radius", "X", "Y", "Z", "VX", "VY", "VZ" };
+                static constexpr uint32_t colorBit = 1u << fieldCount;
+                static constexpr uint32_t required = ((1u << fieldCount) - 1) | colorBit;
+                static constexpr size_t unset = SIZE_MAX;
+
+                BodyStore& bodies;
+                RenderTable& render;
+                size_t first;
+
+                State state = State::Document;
+                int skipDepth = 0;      // Nesting depth inside an unknown value that is being skipped
+                std::string currentKey;
+                int field = -1;         // Index into fieldNames of the current key, -1 for anything else
+                bool sawObjects = false;
+                size_t declaredCount = unset;
+
+                // The object being read
+                double values[fieldCount];
+                uint32_t seen = 0;
+                std::string name;
+                glm::vec3 objectColor;
+
+                // Scale to meters, seconds and kilograms, applied by finish()
+                double lengthScale = 1000.0;
+                double timeScale = 1.0;
+                double massScale = 1.0;
+
+                bool fail(const std::string& message) {
+                    if (error.empty()) error = message;
+                    return false;
+                }
+
+                std::string objectName() const {
+                    std::string text = "object " + std::to_string(bodies.size() - first);
+                    return name.empty() ? text : text + " (" + name + ")";
+                }
+
+                /**
+                 * What the schema wants at the current position, nullptr under keys it doesn't know, whose values are skipped
+                 */
+                const char* expected() const {
+                    switch (state) {
+                        case State::Document: return "an object";
+                        case State::TopLevel:
+                            if (currentKey == "count") return "a number";
+                            if (currentKey == "objects") return "an array";
+                            if (currentKey == "units") return "an object";
+                            return nullptr;
+                        case State::Units: return "a string";
+                        case State::Objects: return "an object";
+                        case State::Object:
+                            if (field >= 0) return "a number";
+                            if (currentKey == "name" || currentKey == "color") return "a string";
+                            return nullptr;
+                        default: return "the end of the file";
+                    }
+                }
+
+                /**
+                 * A value the handlers above didn't take, skipped under unknown keys and an error anywhere else
+                 */
+                bool other(const char* kind) {
+                    const char* wanted = expected();
+                    if (!wanted) {
+                        // Containers are skipped up to their matching end
+                        if (std::string(kind) == "an object" || std::string(kind) == "an array") skipDepth++;
+                        return true;
+                    }
+                    std::string where = state == State::Object ? objectName() + " " + currentKey
+                                      : currentKey.empty() ? std::string("the document") : currentKey;
+                    return fail(where + " is " + kind + ", expected " + wanted);
+                }
+
+                bool unit(const std::string& text) {
+                    if (currentKey == "length") {
+                        if (text == "m") lengthScale = 1.0;
+                        else if (text == "km") lengthScale = 1000.0;
+                        else if (text == "au") lengthScale = 1.495978707e11;
+                        else return fail("unknown length unit " + text + ", expected m, km or au");
+                    }
+                    else if (currentKey == "time") {
+                        if (text == "s") timeScale = 1.0;
+                        else if (text == "day") timeScale = 86400.0;
+                        else return fail("unknown time unit " + text + ", expected s or day");
+                    }
+                    else if (currentKey == "mass") {
+                        if (text == "kg") massScale = 1.0;
+                        else if (text == "solar") massScale = 1.98841e30;
+                        else return fail("unknown mass unit " + text + ", expected kg or solar");
+                    }
+                    else {
+                        return fail("unknown unit " + currentKey + ", expected length, time or mass");
+                    }
+                    return true;
+                }
+
+                bool addObject() {
+                    if ((seen & required) != required) {
+                        std::string missing;
+                        for (int f = 0; f < fieldCount; f++) {
+                            if (!(seen & (1u << f))) missing += std::string(missing.empty() ? "" : ", ") + fieldNames[f];
+                        }
+                        if (!(seen & colorBit)) missing += std::string(missing.empty() ? "" : ", ") + "color";
+                        return fail(objectName() + " is missing " + missing);
+                    }
+                    if (values[0] < 0.0) return fail(objectName() + " has a negative mass");
+                    if (values[1] < 0.0) return fail(objectName() + " has a negative radius");
+                    bodies.add(glm::dvec3(values[2], values[3], values[4]), glm::dvec3(values[5], values[6], values[7]), values[0], values[1]);
+                    render.add(objectColor, bodies.ids.back());
+                    return true;
+                }
+        };
+};
+
+#endif //OPENGLPRACTICE_SCENARIOLOADER_H
@@ -0,0 +1,97 @@
+/*
+ * On disk layout shared by TrajectoryWriter and TrajectoryReader.
+ *
+ * [TrajectoryHeader][radii: double x N][colors: vec3 x N] [chunk] [chunk] ... [chunk offsets: u64 x C][TrajectoryFooter]
+ *
+ * Frames are grouped into chunks of up to framesPerChunk frames. A chunk is a TrajectoryChunkHeader, the time and step of
+ * every frame, then one column per state component (x, y, z, vx, vy, vz). Each column holds the chunk's first frame as
+ * raw doubles (the keyframe) followed by every later frame as float offsets from that keyframe, so any frame can be
+ * decoded in O(1) and the error stays relative to how far a body moved within the chunk, not to its distance from the origin.
+ * Every section starts on an 8 byte boundary. The footer is written on close; a file without one (a crashed run) can still
+ * be read by walking the chunk headers from the front.
+ */
+
+#ifndef OPENGLPRACTICE_TRAJECTORYFORMAT_H
+#define OPENGLPRACTICE_TRAJECTORYFORMAT_H
+
+#include <cstdint>
+#include <type_traits>
+
+#include <glm/glm.hpp>
+
+struct TrajectoryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t bodyCount;
+    uint32_t framesPerChunk;
+    uint32_t reserved;
+    double dt;              // Simulation step size, informational
+};
+
+struct TrajectoryChunkHeader {
+    uint32_t magic;
+    uint32_t frameCount;
+    uint64_t firstFrame;    // Index of the chunk's first frame within the file
+    uint64_t byteSize;      // Whole chunk including this header
+};
+
+struct TrajectoryFooter {
+    uint64_t chunkCount;
+    uint64_t frameCount;
+    uint64_t indexOffset;   // Byte offset of the chunk offset table
+    char magic[8];
+};
+
+static_assert(std::is_trivially_copyable_v<TrajectoryHeader> && sizeof(TrajectoryHeader) == 40, "TrajectoryHeader must not contain padding");
+static_assert(std::is_trivially_copyable_v<TrajectoryChunkHeader> && sizeof(TrajectoryChunkHeader) == 24, "TrajectoryChunkHeader must not contain padding");
+static_assert(std::is_trivially_copyable_v<TrajectoryFooter> && sizeof(TrajectoryFooter) == 32, "TrajectoryFooter must not contain padding");
+
+namespace TrajectoryFormat {
+    constexpr char headerMagic[8] = { 'O', 'G', 'P', 'T', 'R', 'A', 'J', '\0' };
+    constexpr char footerMagic[8] = { 'O', 'G', 'P', 'T', 'E', 'N', 'D', '\0' };
+    constexpr uint32_t chunkMagic = 0x4B4E4843; // "CHNK"
+    constexpr uint32_t version = 1;
+    constexpr uint32_t byteOrderMark = 0x01020304;
+    constexpr int columnCount = 6;
+
+    inline uint64_t alignUp(uint64_t offset) {
+        return (offset + 7) / 8 * 8;
+    }
+
+    // Static per body data directly after the header
+    inline uint64_t radiiOffset() {
+        return sizeof(TrajectoryHeader);
+    }
+
+    inline uint64_t colorsOffset(uint64_t bodies) {
+        return radiiOffset() + bodies * sizeof(double);
+    }
+
+    inline uint64_t firstChunkOffset(uint64_t bodies) {
+        return alignUp(colorsOffset(bodies) + bodies * sizeof(glm::vec3));
+    }
+
+    // Offsets within a chunk, relative to the start of its header
+    inline uint64_t timesOffset() {
+        return sizeof(TrajectoryChunkHeader);
+    }
+
+    inline uint64_t stepsOffset(uint32_t frames) {
+        return timesOffset() + frames * sizeof(double);
+    }
+
+    inline uint64_t columnBytes(uint64_t bodies, uint32_t frames) {
+        return alignUp(bodies * sizeof(double) + bodies * (frames - 1) * sizeof(float));
+    }
+
+    inline uint64_t columnOffset(int column, uint64_t bodies, uint32_t frames) {
+        return stepsOffset(frames) + frames * sizeof(uint64_t) + column * columnBytes(bodies, frames);
+    }
+
+    inline uint64_t chunkBytes(uint64_t bodies, uint32_t frames) {
+        return columnOffset(columnCount, bodies, frames);
+    }
+}
+
+#endif //OPENGLPRACTICE_TRAJECTORYFORMAT_H
@@ -0,0 +1,238 @@
+/*
+ * Random access reader for files written by TrajectoryWriter.
+ * The file is memory-mapped and frames are decoded on demand, so only the chunks around the requested time are ever paged in.
+ * sample() finds the two stored frames around a time with a binary search and joins them with a cubic Hermite curve
+ * through the stored positions and velocities, which follows curved orbits far better than a straight line between frames.
+ */
+
+#ifndef OPENGLPRACTICE_TRAJECTORYREADER_H
+#define OPENGLPRACTICE_TRAJECTORYREADER_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+
+#include "IO/MappedFile.h"
+#include "IO/TrajectoryFormat.h"
+#include "World/SimulationSnapshot.h"
+
+class TrajectoryReader {
+    public:
+        TrajectoryReader(const std::string& path) : file(path) {
+            if (file.size() < sizeof(TrajectoryHeader)) {
+                throw std::runtime_error(path + " is not a trajectory");
+            }
+            std::memcpy(&header, file.data(), sizeof(header));
+            if (std::memcmp(header.magic, TrajectoryFormat::headerMagic, sizeof(header.magic)) != 0) {
+                throw std::runtime_error(path + " is not a trajectory");
+            }
+            if (header.byteOrder != TrajectoryFormat::byteOrderMark || header.version != TrajectoryFormat::version) {
+                throw std::runtime_error(path + " has an unsupported trajectory version or byte order");
+            }
+            if (file.size() < TrajectoryFormat::firstChunkOffset(header.bodyCount)) {
+                throw std::runtime_error(path + " is truncated");
+            }
+
+            indexChunks();
+            if (chunks.empty()) {
+                throw std::runtime_error(path + " contains no frames");
+            }
+        }
+
+        size_t bodyCount() const {
+            return header.bodyCount;
+        }
+
+        uint64_t frameCount() const {
+            return frames;
+        }
+
+        const double* radii() const {
+            return reinterpret_cast<const double*>(file.data() + TrajectoryFormat::radiiOffset());
+        }
+
+        glm::vec3 color(size_t body) const {
+            glm::vec3 value;
+            std::memcpy(&value, file.data() + TrajectoryFormat::colorsOffset(header.bodyCount) + body * sizeof(glm::vec3), sizeof(value));
+            return value;
+        }
+
+        double startTime() const {
+            return frameTime(0);
+        }
+
+        double endTime() const {
+            return frameTime(frames - 1);
+        }
+
+        double frameTime(uint64_t frame) const {
+            const ChunkInfo& chunk = chunkOf(frame);
+            return times(chunk)[frame - chunk.firstFrame];
+        }
+
+        uint64_t frameStep(uint64_t frame) const {
+            const ChunkInfo& chunk = chunkOf(frame);
+            uint64_t step;
+            std::memcpy(&step, chunkData(chunk) + TrajectoryFormat::stepsOffset(chunk.frameCount) + (frame - chunk.firstFrame) * sizeof(uint64_t), sizeof(step));
+            return step;
+        }
+
+        /**
+         * Last frame stored at or before time, clamped to the first and last frame
+         */
+        uint64_t frameAt(double time) const {
+            // Chunk whose first frame is the last one at or before time, then the frame within it
+            auto next = std::upper_bound(chunks.begin(), chunks.end(), time, [this](double t, const ChunkInfo& chunk) {
+                return t < times(chunk)[0];
+            });
+            if (next == chunks.begin()) return 0;
+            const ChunkInfo& chunk = *(next - 1);
+            const double* chunkTimes = times(chunk);
+            uint64_t within = std::upper_bound(chunkTimes, chunkTimes + chunk.frameCount, time) - chunkTimes - 1;
+            return chunk.firstFrame + within;
+        }
+
+        /**
+         * Decodes one stored frame, either output may be nullptr when it isn't wanted
+         */
+        void readFrame(uint64_t frame, glm::dvec3* positions, glm::dvec3* velocities) const {
+            const ChunkInfo& chunk = chunkOf(frame);
+            uint32_t within = static_cast<uint32_t>(frame - chunk.firstFrame);
+            glm::dvec3* outputs[2] = { positions, velocities };
+            for (int c = 0; c < TrajectoryFormat::columnCount; c++) {
+                glm::dvec3* out = outputs[c / 3];
+                if (!out) continue;
+                const uint8_t* column = chunkData(chunk) + TrajectoryFormat::columnOffset(c, header.bodyCount, chunk.frameCount);
+                const double* keys = reinterpret_cast<const double*>(column);
+                if (within == 0) {
+                    for (size_t i = 0; i < header.bodyCount; i++) {
+                        out[i][c % 3] = keys[i];
+                    }
+                    continue;
+                }
+                const float* deltas = reinterpret_cast<const float*>(column + header.bodyCount * sizeof(double)) + (within - 1) * header.bodyCount;
+                for (size_t i = 0; i < header.bodyCount; i++) {
+                    out[i][c % 3] = keys[i] + deltas[i];
+                }
+            }
+        }
+
+        /**
+         * Fills out with every body's position at time, interpolated between the stored frames around it
+         * Times outside the file are clamped to its first or last frame
+         */
+        void sample(double time, SimulationSnapshot& out) {
+            size_t count = header.bodyCount;
+            time = std::clamp(time, startTime(), endTime());
+            uint64_t frame = std::min(frameAt(time), frames - 1);
+            uint64_t following = std::min(frame + 1, frames - 1);
+
+            positions0.resize(count);
+            velocities0.resize(count);
+            positions1.resize(count);
+            velocities1.resize(count);
+            readFrame(frame, positions0.data(), velocities0.data());
+            readFrame(following, positions1.data(), velocities1.data());
+
+            double t0 = frameTime(frame);
+            double h = frameTime(following) - t0;
+            double s = h > 0.0 ? (time - t0) / h : 0.0;
+            // Cubic Hermite basis
+            double h00 = (1.0 + 2.0 * s) * (1.0 - s) * (1.0 - s);
+            double h10 = s * (1.0 - s) * (1.0 - s);
+            double h01 = s * s * (3.0 - 2.0 * s);
+            double h11 = s * s * (s - 1.0);
+
+            out.positions.resize(count);
+            out.radii.resize(count);
+            const double* radius = radii();
+            for (size_t i = 0; i < count; i++) {
+                out.positions[i] = h00 * positions0[i] + h10 * h * velocities0[i] + h01 * positions1[i] + h11 * h * velocities1[i];
+                out.radii[i] = static_cast<float>(radius[i]);
+            }
+            out.time = time;
+            out.step = frameStep(frame);
+        }
+
+    private:
+        struct ChunkInfo {
+            uint64_t offset;
+            uint64_t firstFrame;
+            uint32_t frameCount;
+        };
+
+        MappedFile file;
+        TrajectoryHeader header;
+        std::vector<ChunkInfo> chunks;
+        uint64_t frames = 0;
+
+        // Decode scratch for sample()
+        std::vector<glm::dvec3> positions0, velocities0, positions1, velocities1;
+
+        /**
+         * Reads the chunk index from the footer, or walks the chunk headers when the writer never got to close the file
+         */
+        void indexChunks() {
+            TrajectoryFooter footer;
+            bool hasFooter = file.size() >= TrajectoryFormat::firstChunkOffset(header.bodyCount) + sizeof(footer);
+            if (hasFooter) {
+                std::memcpy(&footer, file.data() + file.size() - sizeof(footer), sizeof(footer));
+                hasFooter = std::memcmp(footer.magic, TrajectoryFormat::footerMagic, sizeof(footer.magic)) == 0
+                            && footer.indexOffset + footer.chunkCount * sizeof(uint64_t) + sizeof(footer) == file.size();
+            }
+
+            if (hasFooter) {
+                for (uint64_t k = 0; k < footer.chunkCount; k++) {
+                    uint64_t offset;
+                    std::memcpy(&offset, file.data() + footer.indexOffset + k * sizeof(uint64_t), sizeof(offset));
+                    if (!addChunk(offset)) {
+                        throw std::runtime_error("Trajectory chunk index is corrupt");
+                    }
+                }
+            }
+            else {
+                uint64_t offset = TrajectoryFormat::firstChunkOffset(header.bodyCount);
+                while (addChunk(offset)) {
+                    offset += TrajectoryFormat::chunkBytes(header.bodyCount, chunks.back().frameCount);
+                }
+            }
+        }
+
+        /**
+         * Validates the chunk header at offset and appends it to the index, false if it is missing or cut short
+         */
+        bool addChunk(uint64_t offset) {
+            TrajectoryChunkHeader chunk;
+            if (offset + sizeof(chunk) > file.size()) return false;
+            std::memcpy(&chunk, file.data() + offset, sizeof(chunk));
+            if (chunk.magic != TrajectoryFormat::chunkMagic || chunk.frameCount == 0 || chunk.firstFrame != frames
+                || chunk.byteSize != TrajectoryFormat::chunkBytes(header.bodyCount, chunk.frameCount)
+                || offset + chunk.byteSize > file.size()) {
+                return false;
+            }
+            chunks.push_back({ offset, chunk.firstFrame, chunk.frameCount });
+            frames += chunk.frameCount;
+            return true;
+        }
+
+        const ChunkInfo& chunkOf(uint64_t frame) const {
+            auto next = std::upper_bound(chunks.begin(), chunks.end(), frame, [](uint64_t f, const ChunkInfo& chunk) {
+                return f < chunk.firstFrame;
+            });
+            return *(next - 1);
+        }
+
+        const uint8_t* chunkData(const ChunkInfo& chunk) const {
+            return file.data() + chunk.offset;
+        }
+
+        const double* times(const ChunkInfo& chunk) const {
+            return reinterpret_cast<const double*>(chunkData(chunk) + TrajectoryFormat::timesOffset());
+        }
+};
+
+#endif //OPENGLPRACTICE_TRAJECTORYREADER_H
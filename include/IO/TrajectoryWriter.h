@@ -0,0 +1,265 @@
+/*
+ * Streams simulation frames to a chunked trajectory file (see TrajectoryFormat.h) from a background I/O thread.
+ * append() encodes the current state straight into an in-memory chunk, which costs about as much as copying it.
+ * Full chunks are handed to the I/O thread through a fixed pool of buffers, so the step loop only waits
+ * when the disk falls a whole pool behind; stallSeconds() reports how long that has happened for.
+ */
+
+#ifndef OPENGLPRACTICE_TRAJECTORYWRITER_H
+#define OPENGLPRACTICE_TRAJECTORYWRITER_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include "IO/TrajectoryFormat.h"
+#include "World/Simulation.h"
+
+class TrajectoryWriter {
+    public:
+        /**
+         * Creates path and writes the header plus the radii and colors of every body in sim
+         * @param framesPerChunk Frames sharing one keyframe, larger chunks compress better but take more memory per buffer
+         * @param bufferCount Chunks that may be in flight at once, the bound on memory and on how far the disk may lag
+         */
+        TrajectoryWriter(const std::string& path, const Simulation& sim, uint32_t framesPerChunk = 16, int bufferCount = 2)
+            : bodyCount(sim.bodies.size()), framesPerChunk(std::max<uint32_t>(framesPerChunk, 1)) {
+            out.open(path, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                throw std::runtime_error("Failed to open " + path + " for writing");
+            }
+
+            TrajectoryHeader header{};
+            std::memcpy(header.magic, TrajectoryFormat::headerMagic, sizeof(header.magic));
+            header.version = TrajectoryFormat::version;
+            header.byteOrder = TrajectoryFormat::byteOrderMark;
+            header.bodyCount = bodyCount;
+            header.framesPerChunk = this->framesPerChunk;
+            header.dt = sim.dt;
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(sim.bodies.radius.data()), bodyCount * sizeof(double));
+            std::vector<glm::vec3> colors(bodyCount, glm::vec3(1.0f));
+            std::copy_n(sim.render.colors.begin(), std::min(bodyCount, sim.render.colors.size()), colors.begin());
+            out.write(reinterpret_cast<const char*>(colors.data()), bodyCount * sizeof(glm::vec3));
+            position = TrajectoryFormat::colorsOffset(bodyCount) + bodyCount * sizeof(glm::vec3);
+            writePadding(TrajectoryFormat::firstChunkOffset(bodyCount));
+
+            for (int i = 0; i < std::max(bufferCount, 1); i++) {
+                freeChunks.push_back(std::make_unique<Chunk>());
+            }
+            worker = std::thread([this] { run(); });
+        }
+
+        ~TrajectoryWriter() {
+            try {
+                close();
+            }
+            catch (...) {
+
+            }
+        }
+
+        TrajectoryWriter(const TrajectoryWriter&) = delete;
+        TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+        /**
+         * Records the current state of sim as the next frame, only blocks while every buffer is waiting on the disk
+         */
+        void append(const Simulation& sim) {
+            const BodyStore& bodies = sim.bodies;
+            if (bodies.size() != bodyCount) {
+                throw std::runtime_error("Trajectory body count changed from " + std::to_string(bodyCount) + " to " + std::to_string(bodies.size()));
+            }
+            if (!current) {
+                current = acquireChunk();
+            }
+
+            Chunk& chunk = *current;
+            uint32_t frame = chunk.frameCount;
+            chunk.times[frame] = sim.time;
+            chunk.steps[frame] = sim.steps;
+            const std::vector<double>* columns[TrajectoryFormat::columnCount] = { &bodies.x, &bodies.y, &bodies.z, &bodies.vx, &bodies.vy, &bodies.vz };
+            for (int c = 0; c < TrajectoryFormat::columnCount; c++) {
+                const double* values = columns[c]->data();
+                double* key = chunk.keys[c].data();
+                if (frame == 0) {
+                    std::copy_n(values, bodyCount, key);
+                }
+                else {
+                    float* deltas = chunk.deltas[c].data() + (frame - 1) * bodyCount;
+                    for (size_t i = 0; i < bodyCount; i++) {
+                        deltas[i] = static_cast<float>(values[i] - key[i]);
+                    }
+                }
+            }
+            chunk.firstFrame = frame == 0 ? framesAppended : chunk.firstFrame;
+            chunk.frameCount++;
+            framesAppended++;
+
+            if (chunk.frameCount == framesPerChunk) {
+                submit();
+            }
+        }
+
+        /**
+         * Writes any partial chunk, waits for the I/O thread to drain and finishes the file with the chunk index
+         */
+        void close() {
+            if (!worker.joinable()) return;
+            if (current && current->frameCount > 0) {
+                submit();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closing = true;
+            }
+            filled.notify_one();
+            worker.join();
+
+            TrajectoryFooter footer{};
+            footer.chunkCount = chunkOffsets.size();
+            footer.frameCount = framesAppended;
+            footer.indexOffset = position;
+            std::memcpy(footer.magic, TrajectoryFormat::footerMagic, sizeof(footer.magic));
+            out.write(reinterpret_cast<const char*>(chunkOffsets.data()), chunkOffsets.size() * sizeof(uint64_t));
+            out.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+            out.close();
+            if (writeFailed || !out) {
+                throw std::runtime_error("Failed writing trajectory");
+            }
+        }
+
+        uint64_t frames() const {
+            return framesAppended;
+        }
+
+        /**
+         * Wall clock seconds append() spent waiting for a free buffer
+         */
+        double stallSeconds() const {
+            return stalled;
+        }
+
+    private:
+        struct Chunk {
+            uint32_t frameCount = 0;
+            uint64_t firstFrame = 0;
+            std::vector<double> times;
+            std::vector<uint64_t> steps;
+            std::vector<double> keys[TrajectoryFormat::columnCount];
+            std::vector<float> deltas[TrajectoryFormat::columnCount];
+        };
+
+        size_t bodyCount;
+        uint32_t framesPerChunk;
+        std::ofstream out;
+        uint64_t position = 0;  // Bytes written, owned by the I/O thread while it runs
+        std::vector<uint64_t> chunkOffsets;
+
+        std::unique_ptr<Chunk> current;
+        uint64_t framesAppended = 0;
+        double stalled = 0.0;
+
+        std::mutex mutex;
+        std::condition_variable filled, freed;
+        std::deque<std::unique_ptr<Chunk>> freeChunks, fullChunks;
+        bool closing = false;
+        bool writeFailed = false;
+        std::thread worker;
+
+        std::unique_ptr<Chunk> acquireChunk() {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (freeChunks.empty()) {
+                auto start = std::chrono::steady_clock::now();
+                freed.wait(lock, [this] { return !freeChunks.empty(); });
+                stalled += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            std::unique_ptr<Chunk> chunk = std::move(freeChunks.front());
+            freeChunks.pop_front();
+            lock.unlock();
+
+            // Buffers are sized on first use and then recycled
+            chunk->frameCount = 0;
+            chunk->times.resize(framesPerChunk);
+            chunk->steps.resize(framesPerChunk);
+            for (int c = 0; c < TrajectoryFormat::columnCount; c++) {
+                chunk->keys[c].resize(bodyCount);
+                chunk->deltas[c].resize((framesPerChunk - 1) * bodyCount);
+            }
+            return chunk;
+        }
+
+        void submit() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                fullChunks.push_back(std::move(current));
+            }
+            filled.notify_one();
+        }
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                filled.wait(lock, [this] { return closing || !fullChunks.empty(); });
+                if (fullChunks.empty()) return;
+
+                std::unique_ptr<Chunk> chunk = std::move(fullChunks.front());
+                fullChunks.pop_front();
+                lock.unlock();
+
+                uint64_t start = position;
+                writeChunk(*chunk);
+
+                lock.lock();
+                chunkOffsets.push_back(start);
+                freeChunks.push_back(std::move(chunk));
+                freed.notify_one();
+            }
+        }
+
+        /**
+         * Runs on the I/O thread without holding the lock, the chunk is owned by this thread until it goes back to freeChunks
+         */
+        void writeChunk(const Chunk& chunk) {
+            uint32_t frames = chunk.frameCount;
+            uint64_t start = position;
+
+            TrajectoryChunkHeader header{};
+            header.magic = TrajectoryFormat::chunkMagic;
+            header.frameCount = frames;
+            header.firstFrame = chunk.firstFrame;
+            header.byteSize = TrajectoryFormat::chunkBytes(bodyCount, frames);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(chunk.times.data()), frames * sizeof(double));
+            out.write(reinterpret_cast<const char*>(chunk.steps.data()), frames * sizeof(uint64_t));
+            position = start + TrajectoryFormat::columnOffset(0, bodyCount, frames);
+
+            for (int c = 0; c < TrajectoryFormat::columnCount; c++) {
+                out.write(reinterpret_cast<const char*>(chunk.keys[c].data()), bodyCount * sizeof(double));
+                out.write(reinterpret_cast<const char*>(chunk.deltas[c].data()), (frames - 1) * bodyCount * sizeof(float));
+                position += bodyCount * sizeof(double) + (frames - 1) * bodyCount * sizeof(float);
+                writePadding(start + TrajectoryFormat::columnOffset(c + 1, bodyCount, frames));
+            }
+            if (!out) {
+                writeFailed = true;
+            }
+        }
+
+        void writePadding(uint64_t target) {
+            static const char zeros[8] = {};
+            if (target > position) {
+                out.write(zeros, target - position);
+            }
+            position = target;
+        }
+};
+
+#endif //OPENGLPRACTICE_TRAJECTORYWRITER_H
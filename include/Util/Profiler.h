@@ -0,0 +1,297 @@
+/*
+ * Low overhead scoped phase timers for the frame and step loops.
+ * PROFILE_SCOPE("name") times the rest of the enclosing block and files it under the named phase. Each thread appends
+ * to its own bounded ring of events, so recording costs two clock reads and an uncontended lock.
+ * PROFILE_SELF_SCOPE("name") files only the block's own time, without the scopes nested inside it on the same thread.
+ * The simulation uses it for "integrate", the integrator's work in a step without its "force" evaluations.
+ * The rings feed both rolling percentiles per phase (summarize(), overlay(), writeCsv()) and a Chrome trace
+ * (writeChromeTrace(), open it in chrome://tracing or Perfetto). GPU phases are filed by GpuTimer.
+ *
+ * Everything is compiled in only when OPENGLPRACTICE_PROFILE is defined (the ENABLE_PROFILER CMake option).
+ * Without it the macros expand to nothing and no profiler code ends up in the binary.
+ */
+
+#ifndef OPENGLPRACTICE_PROFILER_H
+#define OPENGLPRACTICE_PROFILER_H
+
+#ifdef OPENGLPRACTICE_PROFILE
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+
+class Profiler {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /**
+         * Rolling statistics of one phase over the events still held in the rings, times in milliseconds
+         */
+        struct PhaseSummary {
+            std::string name;
+            bool gpu;
+            size_t count;
+            double mean, p50, p90, p99, max;
+        };
+
+        // Events kept per thread, older ones are overwritten
+        static constexpr size_t ringCapacity = 1 << 16;
+
+        static Profiler& instance() {
+            static Profiler profiler;
+            return profiler;
+        }
+
+        /**
+         * Id of the named phase, registering it on first use. Call sites cache the result, see PROFILE_SCOPE
+         */
+        uint32_t phase(const char* name) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (uint32_t i = 0; i < phases.size(); i++) {
+                if (phases[i] == name) return i;
+            }
+            phases.emplace_back(name);
+            return static_cast<uint32_t>(phases.size() - 1);
+        }
+
+        /**
+         * Names the calling thread in reports, e.g. "render" or "simulation"
+         */
+        void setThreadName(const std::string& name) {
+            ThreadLog& log = threadLog();
+            std::lock_guard<std::mutex> lock(log.mutex);
+            log.name = name;
+        }
+
+        void record(uint32_t phase, Clock::time_point start, Clock::time_point end) {
+            append(threadLog(), phase, start, end);
+        }
+
+        /**
+         * Files a GPU measurement, placed on the trace at the CPU time the work was submitted
+         */
+        void recordGpu(uint32_t phase, Clock::time_point submitted, double seconds) {
+            append(*gpuLog, phase, submitted, submitted + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds)));
+        }
+
+        /**
+         * Drops every recorded event, phases and thread names are kept
+         */
+        void reset() {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& log : logs) {
+                std::lock_guard<std::mutex> logLock(log->mutex);
+                log->events.clear();
+                log->next = 0;
+            }
+        }
+
+        std::vector<PhaseSummary> summarize() {
+            std::vector<std::vector<double>> cpu, gpu;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                cpu.resize(phases.size());
+                gpu.resize(phases.size());
+                for (auto& log : logs) {
+                    std::lock_guard<std::mutex> logLock(log->mutex);
+                    auto& durations = log.get() == gpuLog ? gpu : cpu;
+                    for (const Event& event : log->events) {
+                        durations[event.phase].push_back(event.duration * 1e-6);
+                    }
+                }
+            }
+
+            std::vector<PhaseSummary> summaries;
+            for (int side = 0; side < 2; side++) {
+                auto& durations = side == 0 ? cpu : gpu;
+                for (size_t p = 0; p < durations.size(); p++) {
+                    std::vector<double>& values = durations[p];
+                    if (values.empty()) continue;
+                    std::sort(values.begin(), values.end());
+                    double total = 0.0;
+                    for (double value : values) total += value;
+                    summaries.push_back({ phaseName(p), side == 1, values.size(), total / values.size(),
+                                          percentile(values, 0.50), percentile(values, 0.90), percentile(values, 0.99), values.back() });
+                }
+            }
+            return summaries;
+        }
+
+        /**
+         * One line of p50 / p99 milliseconds per phase, short enough for a window title
+         */
+        std::string overlay() {
+            std::string text;
+            char entry[96];
+            for (const PhaseSummary& summary : summarize()) {
+                std::snprintf(entry, sizeof(entry), "%s%s %.2f/%.2f  ", summary.gpu ? "gpu:" : "", summary.name.c_str(), summary.p50, summary.p99);
+                text += entry;
+            }
+            return text;
+        }
+
+        /**
+         * One row per phase: name, cpu or gpu, sample count and the rolling statistics in milliseconds
+         */
+        bool writeCsv(const std::string& path) {
+            std::ofstream out(path);
+            out << "phase,clock,count,mean_ms,p50_ms,p90_ms,p99_ms,max_ms\n";
+            char row[256];
+            for (const PhaseSummary& s : summarize()) {
+                std::snprintf(row, sizeof(row), "%s,%s,%zu,%.6f,%.6f,%.6f,%.6f,%.6f\n", s.name.c_str(), s.gpu ? "gpu" : "cpu",
+                              s.count, s.mean, s.p50, s.p90, s.p99, s.max);
+                out << row;
+            }
+            return static_cast<bool>(out);
+        }
+
+        /**
+         * Every held event as a complete ("X") event of the Chrome trace event format, one trace thread per profiled thread
+         */
+        bool writeChromeTrace(const std::string& path) {
+            std::ofstream out(path);
+            out << "{\"traceEvents\":[\n";
+            bool first = true;
+            char line[256];
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t t = 0; t < logs.size(); t++) {
+                ThreadLog& log = *logs[t];
+                std::lock_guard<std::mutex> logLock(log.mutex);
+                std::snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+                              first ? "" : ",\n", t, log.name.c_str());
+                out << line;
+                first = false;
+                for (const Event& event : log.events) {
+                    std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}",
+                                  phases[event.phase].c_str(), t, (event.start - epoch) * 1e-3, event.duration * 1e-3);
+                    out << line;
+                }
+            }
+            out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+            return static_cast<bool>(out);
+        }
+
+    private:
+        struct Event {
+            uint32_t phase;
+            int64_t start;      // Nanoseconds on Clock
+            int64_t duration;   // Nanoseconds
+        };
+
+        struct ThreadLog {
+            std::mutex mutex;
+            std::string name;
+            std::vector<Event> events;
+            size_t next = 0;
+        };
+
+        std::mutex mutex;
+        std::vector<std::string> phases;
+        std::vector<std::unique_ptr<ThreadLog>> logs;   // Never shrinks, a thread keeps a pointer to its log
+        ThreadLog* gpuLog;
+        int64_t epoch;
+
+        Profiler() {
+            epoch = nanoseconds(Clock::now());
+            gpuLog = newLog("GPU");
+        }
+
+        static int64_t nanoseconds(Clock::time_point time) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        }
+
+        static double percentile(const std::vector<double>& sorted, double fraction) {
+            size_t index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+            return sorted[index];
+        }
+
+        std::string phaseName(size_t phase) {
+            std::lock_guard<std::mutex> lock(mutex);
+            return phases[phase];
+        }
+
+        ThreadLog* newLog(const std::string& name = "") {
+            std::lock_guard<std::mutex> lock(mutex);
+            logs.push_back(std::make_unique<ThreadLog>());
+            logs.back()->name = name.empty() ? "thread " + std::to_string(logs.size() - 1) : name;
+            return logs.back().get();
+        }
+
+        ThreadLog& threadLog() {
+            thread_local ThreadLog* log = newLog();
+            return *log;
+        }
+
+        void append(ThreadLog& log, uint32_t phase, Clock::time_point start, Clock::time_point end) {
+            Event event{ phase, nanoseconds(start), nanoseconds(end) - nanoseconds(start) };
+            std::lock_guard<std::mutex> lock(log.mutex);
+            if (log.events.size() < ringCapacity) {
+                log.events.push_back(event);
+            }
+            else {
+                log.events[log.next] = event;
+                log.next = (log.next + 1) % ringCapacity;
+            }
+        }
+};
+
+/**
+ * Records the time from construction to destruction under one phase
+ * With self set the time of timers nested inside it on the same thread is left out, the event then starts where the block
+ * started and lasts only as long as the block's own work
+ */
+class ScopedTimer {
+    public:
+        ScopedTimer(uint32_t phase, bool self = false) : phase(phase), self(self), parent(innermost), start(Profiler::Clock::now()) {
+            innermost = this;
+        }
+
+        ~ScopedTimer() {
+            Profiler::Clock::time_point end = Profiler::Clock::now();
+            innermost = parent;
+            if (parent) {
+                parent->nested += end - start;
+            }
+            Profiler::instance().record(phase, start, self ? end - nested : end);
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        // Timer the calling thread is currently inside of, the parent of the next one constructed
+        static inline thread_local ScopedTimer* innermost = nullptr;
+
+        uint32_t phase;
+        bool self;
+        ScopedTimer* parent;
+        Profiler::Clock::duration nested = Profiler::Clock::duration::zero();
+        Profiler::Clock::time_point start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// Phase ids are looked up once per call site
+#define PROFILE_SCOPE(name) \
+    static const uint32_t PROFILE_CONCAT(profilePhase, __LINE__) = Profiler::instance().phase(name); \
+    ScopedTimer PROFILE_CONCAT(profileTimer, __LINE__)(PROFILE_CONCAT(profilePhase, __LINE__))
+#define PROFILE_SELF_SCOPE(name) \
+    static const uint32_t PROFILE_CONCAT(profilePhase, __LINE__) = Profiler::instance().phase(name); \
+    ScopedTimer PROFILE_CONCAT(profileTimer, __LINE__)(PROFILE_CONCAT(profilePhase, __LINE__), true)
+#define PROFILE_THREAD(name) Profiler::instance().setThreadName(name)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_SELF_SCOPE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+
+#endif // OPENGLPRACTICE_PROFILE
+
+#endif //OPENGLPRACTICE_PROFILER_H
@@ -0,0 +1,141 @@
+/*
+ * Reusable work-stealing thread pool.
+ * Every worker owns a task deque, popping its own work from the front and stealing from the back of the others when it runs dry.
+ * parallelFor() splits an index range into fixed size tiles, and the calling thread helps run tiles until the whole range is done.
+ */
+
+#ifndef OPENGLPRACTICE_THREADPOOL_H
+#define OPENGLPRACTICE_THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <algorithm>
+
+class ThreadPool {
+    public:
+        ThreadPool(unsigned threads = std::thread::hardware_concurrency()) {
+            if (threads == 0) threads = 1;
+            for (unsigned i = 0; i < threads; i++) {
+                queues.push_back(std::make_unique<WorkQueue>());
+            }
+            for (unsigned i = 0; i < threads; i++) {
+                workers.emplace_back([this, i] { workerLoop(i); });
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t threadCount() const {
+            return workers.size();
+        }
+
+        /**
+         * Runs body(tileBegin, tileEnd) over [begin, end) in tiles of at most tileSize indices and blocks until every tile is done
+         * Tiles always cover the same index ranges, so any per index reduction happens in the same order as a serial loop
+         */
+        void parallelFor(size_t begin, size_t end, size_t tileSize, const std::function<void(size_t, size_t)>& body) {
+            if (begin >= end) return;
+            if (tileSize == 0) tileSize = 1;
+
+            std::atomic<size_t> remaining((end - begin + tileSize - 1) / tileSize);
+            for (size_t tile = begin; tile < end; tile += tileSize) {
+                size_t tileEnd = std::min(tile + tileSize, end);
+                submit([&body, &remaining, tile, tileEnd] {
+                    body(tile, tileEnd);
+                    remaining.fetch_sub(1, std::memory_order_release);
+                });
+            }
+
+            // The caller steals work too instead of idling until the workers finish
+            size_t home = nextQueue.load(std::memory_order_relaxed);
+            while (remaining.load(std::memory_order_acquire) > 0) {
+                if (!tryRunTask(home)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+    private:
+        struct WorkQueue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<WorkQueue>> queues;
+        std::vector<std::thread> workers;
+
+        std::atomic<size_t> queued{0};
+        std::atomic<size_t> nextQueue{0};
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        bool stopping = false;
+
+        void submit(std::function<void()> task) {
+            size_t target = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+            {
+                std::lock_guard<std::mutex> lock(queues[target]->mutex);
+                queues[target]->tasks.push_back(std::move(task));
+            }
+            queued.fetch_add(1, std::memory_order_release);
+
+            // Taking the sleep lock orders this wake up after any worker that is about to wait
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            wake.notify_one();
+        }
+
+        /**
+         * Pops from the front of the home queue, otherwise steals from the back of the others
+         */
+        bool tryRunTask(size_t home) {
+            std::function<void()> task;
+            for (size_t k = 0; k < queues.size() && !task; k++) {
+                WorkQueue& queue = *queues[(home + k) % queues.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.tasks.empty()) continue;
+
+                if (k == 0) {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+                else {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                }
+            }
+            if (!task) return false;
+
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            return true;
+        }
+
+        void workerLoop(size_t index) {
+            while (true) {
+                if (tryRunTask(index)) continue;
+
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+                if (stopping && queued.load(std::memory_order_acquire) == 0) return;
+            }
+        }
+};
+
+#endif //OPENGLPRACTICE_THREADPOOL_H
@@ -0,0 +1,153 @@
+/*
+ * Structure-of-arrays storage for the physical state of every body in the simulation.
+ * State is kept in double precision: at Neptune distances a float only resolves about half a megameter,
+ * and values are only converted to float when they are handed to the renderer.
+ * Each quantity lives in its own contiguous array and body i is index i in all of them,
+ * so the force loops stream through dense memory instead of chasing per-object pointers.
+ * Anything only needed for drawing lives in the RenderTable side table, under the same index.
+ */
+
+#ifndef OPENGLPRACTICE_BODYSTORE_H
+#define OPENGLPRACTICE_BODYSTORE_H
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <numeric>
+
+#include <glm/glm.hpp>
+
+class BodyStore {
+    public:
+        // Positions
+        std::vector<double> x, y, z;
+        // Velocities
+        std::vector<double> vx, vy, vz;
+        std::vector<double> mass;
+        std::vector<double> radius;
+        // Stable identity of every body, unchanged when compact() shifts it to a lower index
+        std::vector<uint32_t> ids;
+
+        size_t size() const {
+            return mass.size();
+        }
+
+        bool empty() const {
+            return mass.empty();
+        }
+
+        void reserve(size_t count) {
+            for (auto* array : arrays()) {
+                array->reserve(count);
+            }
+            ids.reserve(count);
+        }
+
+        void clear() {
+            for (auto* array : arrays()) {
+                array->clear();
+            }
+            ids.clear();
+            nextId = 0;
+        }
+
+        /**
+         * Append a body to the end of every array
+         * @return The index of the new body
+         */
+        size_t add(glm::dvec3 position, glm::dvec3 velocity, double mass, double radius) {
+            x.push_back(position.x);
+            y.push_back(position.y);
+            z.push_back(position.z);
+            vx.push_back(velocity.x);
+            vy.push_back(velocity.y);
+            vz.push_back(velocity.z);
+            this->mass.push_back(mass);
+            this->radius.push_back(radius);
+            ids.push_back(nextId++);
+            return size() - 1;
+        }
+
+        /**
+         * Appends count zeroed bodies in one go, for generators that fill the arrays directly (in parallel)
+         * @return The index of the first new body
+         */
+        size_t extend(size_t count) {
+            size_t first = size();
+            for (auto* array : arrays()) {
+                array->resize(first + count, 0.0);
+            }
+            ids.resize(first + count);
+            std::iota(ids.begin() + first, ids.end(), nextId);
+            nextId += static_cast<uint32_t>(count);
+            return first;
+        }
+
+        /**
+         * Removes every body whose keep flag is 0, shifting the survivors down in their original order
+         * Works in place, so no array is reallocated
+         * @return The number of bodies left
+         */
+        size_t compact(const std::vector<uint8_t>& keep) {
+            size_t count = size();
+            size_t kept = 0;
+            std::array<std::vector<double>*, 8> columns = arrays();
+            for (size_t i = 0; i < count; i++) {
+                if (!keep[i]) continue;
+                if (kept != i) {
+                    for (auto* array : columns) {
+                        (*array)[kept] = (*array)[i];
+                    }
+                    ids[kept] = ids[i];
+                }
+                kept++;
+            }
+            for (auto* array : columns) {
+                array->resize(kept);
+            }
+            ids.resize(kept);
+            return kept;
+        }
+
+        /**
+         * Numbers every body by its index, for when the arrays were filled directly rather than through add()
+         */
+        void resetIds() {
+            ids.resize(size());
+            std::iota(ids.begin(), ids.end(), 0u);
+            nextId = static_cast<uint32_t>(size());
+        }
+
+        /**
+         * Id the next added body gets, saved by checkpoints so a restored run keeps numbering where it stopped
+         */
+        uint32_t nextFreeId() const {
+            return nextId;
+        }
+
+        /**
+         * Replaces every id with saved ones, one per body, for restoring a checkpoint
+         */
+        void restoreIds(const std::vector<uint32_t>& saved, uint32_t next) {
+            ids = saved;
+            ids.resize(size());
+            nextId = next;
+        }
+
+        glm::dvec3 position(size_t i) const {
+            return glm::dvec3(x[i], y[i], z[i]);
+        }
+
+        glm::dvec3 velocity(size_t i) const {
+            return glm::dvec3(vx[i], vy[i], vz[i]);
+        }
+
+    private:
+        uint32_t nextId = 0;
+
+        std::array<std::vector<double>*, 8> arrays() {
+            return { &x, &y, &z, &vx, &vy, &vz, &mass, &radius };
+        }
+};
+
+#endif //OPENGLPRACTICE_BODYSTORE_H
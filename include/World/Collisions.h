@@ -0,0 +1,303 @@
+/*
+ * Continuous collision detection and response between the spheres of a BodyStore.
+ * The broad phase is sort-based sweep-and-prune: every body is boxed by the volume its sphere sweeps over the step,
+ * the boxes are kept sorted by their low x edge and only boxes that overlap on all three axes reach the narrow phase.
+ * Bodies move little between steps, so the order from the previous step is nearly sorted and an insertion sort
+ * repairs it in close to linear time.
+ * The narrow phase treats each body as moving in a straight line over the step and solves for the first moment the
+ * two spheres touch, so a fast body cannot pass through another between two steps.
+ */
+
+#ifndef OPENGLPRACTICE_COLLISIONS_H
+#define OPENGLPRACTICE_COLLISIONS_H
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "BodyStore.h"
+
+/**
+ * Two bodies touching during a step, by index into the BodyStore as it was when they were detected
+ * time is the fraction of the step at which they first touched, 0 when they already overlapped at its start
+ */
+struct Collision {
+    uint32_t first, second;
+    double time;
+};
+
+/**
+ * What happens to two bodies that touch
+ * Merge joins them into one body conserving mass and momentum, Bounce reflects their approach speed along the contact normal
+ */
+enum class CollisionResponse {
+    None,
+    Merge,
+    Bounce,
+};
+
+class CollisionDetector {
+    public:
+        CollisionResponse response = CollisionResponse::None;
+        double restitution = 1.0;   // Fraction of the approach speed kept by a Bounce, 1 is perfectly elastic
+
+        // Called for every collision before it is resolved, bodies is still in its pre-collision state
+        std::function<void(const Collision&, const BodyStore&)> onCollision;
+
+        bool enabled() const {
+            return response != CollisionResponse::None;
+        }
+
+        /**
+         * Records where every body starts the step, the sweep of each body runs from here to its position after the step
+         */
+        void beginStep(const BodyStore& bodies) {
+            startX = bodies.x;
+            startY = bodies.y;
+            startZ = bodies.z;
+        }
+
+        /**
+         * Finds every pair of bodies that touched between beginStep() and now, sorted by the time they first touched
+         */
+        const std::vector<Collision>& detect(const BodyStore& bodies) {
+            size_t count = bodies.size();
+            found.clear();
+            if (count < 2 || startX.size() != count) return found;
+
+            computeBounds(bodies);
+            sortByLowX();
+
+            // Sweep along x, active holds every box whose x extent still reaches the current one
+            active.clear();
+            for (uint32_t i : order) {
+                double low = boxes[i].low.x;
+                for (size_t k = 0; k < active.size();) {
+                    uint32_t j = active[k];
+                    if (boxes[j].high.x < low) {
+                        active[k] = active.back();
+                        active.pop_back();
+                        continue;
+                    }
+                    k++;
+                    if (boxes[j].high.y < boxes[i].low.y || boxes[i].high.y < boxes[j].low.y
+                        || boxes[j].high.z < boxes[i].low.z || boxes[i].high.z < boxes[j].low.z) {
+                        continue;
+                    }
+                    double time;
+                    if (sweptSpheres(bodies, std::min(i, j), std::max(i, j), time)) {
+                        found.push_back({ std::min(i, j), std::max(i, j), time });
+                    }
+                }
+                active.push_back(i);
+            }
+
+            std::sort(found.begin(), found.end(), [](const Collision& a, const Collision& b) {
+                return a.time < b.time || (a.time == b.time && (a.first < b.first || (a.first == b.first && a.second < b.second)));
+            });
+            return found;
+        }
+
+        /**
+         * Detects and resolves every collision of the step, in the order they happened
+         * A body merged away earlier in the step takes no part in later collisions
+         * Removed bodies are compacted out of bodies in place
+         * @param dt Length of the step, bounced bodies are moved back to the point of contact and on with their new velocity
+         * @return The number of collisions resolved
+         */
+        size_t resolve(BodyStore& bodies, double dt) {
+            const std::vector<Collision>& collisions = detect(bodies);
+            if (collisions.empty()) return 0;
+
+            keep.assign(bodies.size(), 1);
+            size_t resolved = 0;
+            for (const Collision& collision : collisions) {
+                uint32_t a = collision.first, b = collision.second;
+                if (!keep[a] || !keep[b]) continue;
+                if (onCollision) {
+                    onCollision(collision, bodies);
+                }
+                if (response == CollisionResponse::Merge) {
+                    keep[merge(bodies, a, b)] = 0;
+                }
+                else {
+                    bounce(bodies, collision, dt);
+                }
+                resolved++;
+            }
+
+            if (response == CollisionResponse::Merge) {
+                compactOrder();
+                bodies.compact(keep);
+            }
+            return resolved;
+        }
+
+    private:
+        struct Box {
+            glm::dvec3 low, high;
+        };
+
+        std::vector<double> startX, startY, startZ;
+        std::vector<Box> boxes;
+        std::vector<uint32_t> order;    // Body indices sorted by boxes[i].low.x, carried between steps
+        std::vector<uint32_t> active;
+        std::vector<Collision> found;
+        std::vector<uint8_t> keep;
+
+        void computeBounds(const BodyStore& bodies) {
+            size_t count = bodies.size();
+            boxes.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                glm::dvec3 start(startX[i], startY[i], startZ[i]);
+                glm::dvec3 end = bodies.position(i);
+                glm::dvec3 radius(bodies.radius[i]);
+                boxes[i] = { glm::min(start, end) - radius, glm::max(start, end) + radius };
+            }
+        }
+
+        /**
+         * Insertion sort of the previous step's order, falling back to a full sort when it turns out not to be nearly sorted
+         */
+        void sortByLowX() {
+            size_t count = boxes.size();
+            auto lowX = [this](uint32_t a, uint32_t b) { return boxes[a].low.x < boxes[b].low.x; };
+            if (order.size() != count) {
+                order.resize(count);
+                std::iota(order.begin(), order.end(), 0u);
+                std::sort(order.begin(), order.end(), lowX);
+                return;
+            }
+
+            size_t moves = 0, budget = 8 * count;
+            for (size_t i = 1; i < count; i++) {
+                uint32_t value = order[i];
+                size_t j = i;
+                while (j > 0 && lowX(value, order[j - 1])) {
+                    order[j] = order[j - 1];
+                    j--;
+                }
+                order[j] = value;
+                moves += i - j;
+                if (moves > budget) {
+                    std::sort(order.begin(), order.end(), lowX);
+                    return;
+                }
+            }
+        }
+
+        /**
+         * Earliest fraction of the step at which bodies a and b touch, assuming both moved in a straight line over it
+         */
+        bool sweptSpheres(const BodyStore& bodies, uint32_t a, uint32_t b, double& time) const {
+            glm::dvec3 startGap(startX[b] - startX[a], startY[b] - startY[a], startZ[b] - startZ[a]);
+            glm::dvec3 motion = (bodies.position(b) - bodies.position(a)) - startGap;
+            double reach = bodies.radius[a] + bodies.radius[b];
+
+            // |startGap + t * motion|^2 = reach^2
+            double c = glm::dot(startGap, startGap) - reach * reach;
+            double qa = glm::dot(motion, motion);
+            double qb = 2.0 * glm::dot(startGap, motion);
+            if (c <= 0.0) {
+                // Already overlapping, a pair that bounced last step and is moving apart again is not a new collision
+                time = 0.0;
+                return response == CollisionResponse::Merge || qb < 0.0;
+            }
+            if (qa == 0.0 || qb >= 0.0) return false;
+            double discriminant = qb * qb - 4.0 * qa * c;
+            if (discriminant < 0.0) return false;
+            time = (-qb - std::sqrt(discriminant)) / (2.0 * qa);
+            return time <= 1.0;
+        }
+
+        /**
+         * Folds the lighter of a and b into the heavier one, conserving mass, momentum and volume
+         * @return The index of the body that was absorbed
+         */
+        static uint32_t merge(BodyStore& bodies, uint32_t a, uint32_t b) {
+            uint32_t survivor = bodies.mass[a] >= bodies.mass[b] ? a : b;
+            uint32_t absorbed = survivor == a ? b : a;
+            double m1 = bodies.mass[survivor], m2 = bodies.mass[absorbed];
+            double total = m1 + m2;
+
+            glm::dvec3 position = (m1 * bodies.position(survivor) + m2 * bodies.position(absorbed)) / total;
+            glm::dvec3 velocity = (m1 * bodies.velocity(survivor) + m2 * bodies.velocity(absorbed)) / total;
+            double r1 = bodies.radius[survivor], r2 = bodies.radius[absorbed];
+
+            bodies.x[survivor] = position.x;
+            bodies.y[survivor] = position.y;
+            bodies.z[survivor] = position.z;
+            bodies.vx[survivor] = velocity.x;
+            bodies.vy[survivor] = velocity.y;
+            bodies.vz[survivor] = velocity.z;
+            bodies.mass[survivor] = total;
+            bodies.radius[survivor] = std::cbrt(r1 * r1 * r1 + r2 * r2 * r2);
+            return absorbed;
+        }
+
+        /**
+         * Exchanges momentum along the line between the bodies centers at the moment of contact,
+         * then carries both from the contact point through the rest of the step so they don't pass through each other
+         * Bodies that are already separating are left alone, so a pair still overlapping after a bounce isn't pulled back together
+         * A body bouncing twice in one step is only repositioned for the first contact, the second is found from its unbounced path
+         */
+        void bounce(BodyStore& bodies, const Collision& collision, double dt) const {
+            uint32_t a = collision.first, b = collision.second;
+            double t = collision.time;
+            glm::dvec3 startA(startX[a], startY[a], startZ[a]);
+            glm::dvec3 startB(startX[b], startY[b], startZ[b]);
+            glm::dvec3 contactA = startA + t * (bodies.position(a) - startA);
+            glm::dvec3 contactB = startB + t * (bodies.position(b) - startB);
+            glm::dvec3 gap = contactB - contactA;
+            double distance = glm::length(gap);
+            if (distance == 0.0) return;
+            glm::dvec3 normal = gap / distance;
+
+            double approach = glm::dot(bodies.velocity(b) - bodies.velocity(a), normal);
+            if (approach >= 0.0) return;
+            double invA = 1.0 / bodies.mass[a], invB = 1.0 / bodies.mass[b];
+            glm::dvec3 impulse = (-(1.0 + restitution) * approach / (invA + invB)) * normal;
+
+            bodies.vx[a] -= impulse.x * invA;
+            bodies.vy[a] -= impulse.y * invA;
+            bodies.vz[a] -= impulse.z * invA;
+            bodies.vx[b] += impulse.x * invB;
+            bodies.vy[b] += impulse.y * invB;
+            bodies.vz[b] += impulse.z * invB;
+
+            double remaining = (1.0 - t) * dt;
+            glm::dvec3 endA = contactA + remaining * bodies.velocity(a);
+            glm::dvec3 endB = contactB + remaining * bodies.velocity(b);
+            bodies.x[a] = endA.x;
+            bodies.y[a] = endA.y;
+            bodies.z[a] = endA.z;
+            bodies.x[b] = endB.x;
+            bodies.y[b] = endB.y;
+            bodies.z[b] = endB.z;
+        }
+
+        /**
+         * Drops removed bodies from the carried sort order and renumbers the rest to match BodyStore::compact()
+         */
+        void compactOrder() {
+            std::vector<uint32_t>& remap = active;
+            remap.resize(keep.size());
+            uint32_t next = 0;
+            for (size_t i = 0; i < keep.size(); i++) {
+                remap[i] = next;
+                next += keep[i];
+            }
+            size_t kept = 0;
+            for (uint32_t i : order) {
+                if (keep[i]) order[kept++] = remap[i];
+            }
+            order.resize(kept);
+        }
+};
+
+#endif //OPENGLPRACTICE_COLLISIONS_H
@@ -0,0 +1,311 @@
+/*
+ * Vectorized direct summation kernel for the gravitational acceleration acting on a single target.
+ * The sources are streamed straight out of the BodyStore arrays. The double precision kernel used by the simulation handles
+ * 4 (AVX2) or 8 (AVX-512) bodies per instruction, the float kernel 8 or 16 and is kept for cheap previews and benchmarking.
+ * The inverse distance uses the hardware reciprocal square root followed by Newton-Raphson refinement, except for AVX2 doubles
+ * which have no such instruction and use a full square root and divide.
+ * A Plummer softening length replaces the old overlap check so the loop has no branches.
+ * The implementation is picked once at runtime from the CPU features, with a scalar fallback everywhere else.
+ */
+
+#ifndef OPENGLPRACTICE_GRAVITYKERNEL_H
+#define OPENGLPRACTICE_GRAVITYKERNEL_H
+
+#include <cmath>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OPENGLPRACTICE_KERNEL_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+enum class KernelIsa {
+    Scalar,
+    AVX2,
+    AVX512,
+};
+
+class GravityKernel {
+    public:
+        /**
+         * Signatures shared by every implementation
+         * Sums mass[j] * d / (|d|^2 + eps2)^(3/2) over all sources, where d is the offset from (px, py, pz) to source j
+         * Sources sitting exactly on the target, the target itself included, contribute nothing
+         */
+        using FloatKernelFn = glm::vec3 (*)(const float* x, const float* y, const float* z, const float* mass, size_t count,
+                                            float px, float py, float pz, float eps2);
+        using DoubleKernelFn = glm::dvec3 (*)(const double* x, const double* y, const double* z, const double* mass, size_t count,
+                                              double px, double py, double pz, double eps2);
+
+        KernelIsa isa;
+
+        GravityKernel() : GravityKernel(detect()) {
+
+        }
+
+        GravityKernel(KernelIsa isa) {
+            if (!supported(isa)) isa = KernelIsa::Scalar;
+            this->isa = isa;
+            floatKernel = selectFloat(isa);
+            doubleKernel = selectDouble(isa);
+        }
+
+        /**
+         * Acceleration acting at (px, py, pz) from count sources, already multiplied by G
+         */
+        glm::dvec3 acceleration(const double* x, const double* y, const double* z, const double* mass, size_t count,
+                                double px, double py, double pz, double G, double softening) const {
+            return G * doubleKernel(x, y, z, mass, count, px, py, pz, softening * softening);
+        }
+
+        glm::vec3 acceleration(const float* x, const float* y, const float* z, const float* mass, size_t count,
+                               float px, float py, float pz, float G, float softening) const {
+            return G * floatKernel(x, y, z, mass, count, px, py, pz, softening * softening);
+        }
+
+        /**
+         * The widest implementation this CPU can run
+         */
+        static KernelIsa detect() {
+            if (supported(KernelIsa::AVX512)) return KernelIsa::AVX512;
+            if (supported(KernelIsa::AVX2)) return KernelIsa::AVX2;
+            return KernelIsa::Scalar;
+        }
+
+        static bool supported(KernelIsa isa) {
+            if (isa == KernelIsa::Scalar) return true;
+#ifdef OPENGLPRACTICE_KERNEL_DISPATCH
+            __builtin_cpu_init();
+            if (isa == KernelIsa::AVX2) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            if (isa == KernelIsa::AVX512) return __builtin_cpu_supports("avx512f");
+#endif
+            return false;
+        }
+
+        static const char* name(KernelIsa isa) {
+            switch (isa) {
+                case KernelIsa::AVX2: return "avx2";
+                case KernelIsa::AVX512: return "avx512";
+                default: return "scalar";
+            }
+        }
+
+    private:
+        FloatKernelFn floatKernel;
+        DoubleKernelFn doubleKernel;
+
+        static FloatKernelFn selectFloat(KernelIsa isa) {
+#ifdef OPENGLPRACTICE_KERNEL_DISPATCH
+            if (isa == KernelIsa::AVX512) return accumulateAVX512;
+            if (isa == KernelIsa::AVX2) return accumulateAVX2;
+#endif
+            return accumulateScalar<float>;
+        }
+
+        static DoubleKernelFn selectDouble(KernelIsa isa) {
+#ifdef OPENGLPRACTICE_KERNEL_DISPATCH
+            if (isa == KernelIsa::AVX512) return accumulateAVX512;
+            if (isa == KernelIsa::AVX2) return accumulateAVX2;
+#endif
+            return accumulateScalar<double>;
+        }
+
+        template <typename T>
+        static glm::vec<3, T> accumulateScalar(const T* x, const T* y, const T* z, const T* mass, size_t count,
+                                               T px, T py, T pz, T eps2) {
+            return accumulateRange(x, y, z, mass, 0, count, px, py, pz, eps2);
+        }
+
+        /**
+         * Scalar loop over [begin, end), also used for the tails the vector loops leave behind
+         */
+        template <typename T>
+        static glm::vec<3, T> accumulateRange(const T* x, const T* y, const T* z, const T* mass, size_t begin, size_t end,
+                                              T px, T py, T pz, T eps2) {
+            T accX = 0, accY = 0, accZ = 0;
+            for (size_t j = begin; j < end; j++) {
+                T dx = x[j] - px;
+                T dy = y[j] - py;
+                T dz = z[j] - pz;
+                T r2 = dx * dx + dy * dy + dz * dz + eps2;
+                if (r2 <= 0) continue;
+
+                T invR = 1 / std::sqrt(r2);
+                T scale = mass[j] * invR * invR * invR;
+                accX += scale * dx;
+                accY += scale * dy;
+                accZ += scale * dz;
+            }
+            return glm::vec<3, T>(accX, accY, accZ);
+        }
+
+#ifdef OPENGLPRACTICE_KERNEL_DISPATCH
+        __attribute__((target("avx2,fma")))
+        static float horizontalSum(__m256 v) {
+            __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+            return _mm_cvtss_f32(sum);
+        }
+
+        __attribute__((target("avx2,fma")))
+        static glm::vec3 accumulateAVX2(const float* x, const float* y, const float* z, const float* mass, size_t count,
+                                        float px, float py, float pz, float eps2) {
+            const __m256 targetX = _mm256_set1_ps(px);
+            const __m256 targetY = _mm256_set1_ps(py);
+            const __m256 targetZ = _mm256_set1_ps(pz);
+            const __m256 softening = _mm256_set1_ps(eps2);
+            const __m256 half = _mm256_set1_ps(0.5f);
+            const __m256 threeHalves = _mm256_set1_ps(1.5f);
+            const __m256 zero = _mm256_setzero_ps();
+            __m256 accX = zero, accY = zero, accZ = zero;
+
+            size_t j = 0;
+            for (; j + 8 <= count; j += 8) {
+                __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), targetX);
+                __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), targetY);
+                __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + j), targetZ);
+                __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_fmadd_ps(dz, dz, softening)));
+
+                // rsqrt estimate refined once: y = y * (1.5 - 0.5 * r2 * y * y)
+                __m256 invR = _mm256_rsqrt_ps(r2);
+                invR = _mm256_mul_ps(invR, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(invR, invR), threeHalves));
+
+                __m256 scale = _mm256_mul_ps(_mm256_loadu_ps(mass + j), _mm256_mul_ps(invR, _mm256_mul_ps(invR, invR)));
+                scale = _mm256_and_ps(scale, _mm256_cmp_ps(r2, zero, _CMP_GT_OQ));   // Drop coincident sources
+
+                accX = _mm256_fmadd_ps(scale, dx, accX);
+                accY = _mm256_fmadd_ps(scale, dy, accY);
+                accZ = _mm256_fmadd_ps(scale, dz, accZ);
+            }
+
+            glm::vec3 tail = accumulateRange(x, y, z, mass, j, count, px, py, pz, eps2);
+            return glm::vec3(horizontalSum(accX), horizontalSum(accY), horizontalSum(accZ)) + tail;
+        }
+
+        // GCC 12's AVX-512 intrinsics seed their unused merge operands with _mm512_undefined_*(), a self initialized variable
+        // that -Wall reports as uninitialized wherever they inline. Nothing is read from those operands
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+        __attribute__((target("avx512f")))
+        static glm::vec3 accumulateAVX512(const float* x, const float* y, const float* z, const float* mass, size_t count,
+                                          float px, float py, float pz, float eps2) {
+            const __m512 targetX = _mm512_set1_ps(px);
+            const __m512 targetY = _mm512_set1_ps(py);
+            const __m512 targetZ = _mm512_set1_ps(pz);
+            const __m512 softening = _mm512_set1_ps(eps2);
+            const __m512 half = _mm512_set1_ps(0.5f);
+            const __m512 threeHalves = _mm512_set1_ps(1.5f);
+            const __m512 zero = _mm512_setzero_ps();
+            __m512 accX = zero, accY = zero, accZ = zero;
+
+            size_t j = 0;
+            for (; j + 16 <= count; j += 16) {
+                __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(x + j), targetX);
+                __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(y + j), targetY);
+                __m512 dz = _mm512_sub_ps(_mm512_loadu_ps(z + j), targetZ);
+                __m512 r2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_fmadd_ps(dz, dz, softening)));
+
+                __m512 invR = _mm512_rsqrt14_ps(r2);
+                invR = _mm512_mul_ps(invR, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(invR, invR), threeHalves));
+
+                __m512 scale = _mm512_mul_ps(_mm512_loadu_ps(mass + j), _mm512_mul_ps(invR, _mm512_mul_ps(invR, invR)));
+                __mmask16 valid = _mm512_cmp_ps_mask(r2, zero, _CMP_GT_OQ);
+
+                accX = _mm512_mask3_fmadd_ps(scale, dx, accX, valid);
+                accY = _mm512_mask3_fmadd_ps(scale, dy, accY, valid);
+                accZ = _mm512_mask3_fmadd_ps(scale, dz, accZ, valid);
+            }
+
+            glm::vec3 tail = accumulateRange(x, y, z, mass, j, count, px, py, pz, eps2);
+            return glm::vec3(_mm512_reduce_add_ps(accX), _mm512_reduce_add_ps(accY), _mm512_reduce_add_ps(accZ)) + tail;
+        }
+#pragma GCC diagnostic pop
+
+        __attribute__((target("avx2,fma")))
+        static double horizontalSum(__m256d v) {
+            __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+            sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+            return _mm_cvtsd_f64(sum);
+        }
+
+        __attribute__((target("avx2,fma")))
+        static glm::dvec3 accumulateAVX2(const double* x, const double* y, const double* z, const double* mass, size_t count,
+                                         double px, double py, double pz, double eps2) {
+            const __m256d targetX = _mm256_set1_pd(px);
+            const __m256d targetY = _mm256_set1_pd(py);
+            const __m256d targetZ = _mm256_set1_pd(pz);
+            const __m256d softening = _mm256_set1_pd(eps2);
+            const __m256d one = _mm256_set1_pd(1.0);
+            const __m256d zero = _mm256_setzero_pd();
+            __m256d accX = zero, accY = zero, accZ = zero;
+
+            size_t j = 0;
+            for (; j + 4 <= count; j += 4) {
+                __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), targetX);
+                __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), targetY);
+                __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + j), targetZ);
+                __m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_fmadd_pd(dz, dz, softening)));
+
+                // No double rsqrt before AVX-512, a correctly rounded sqrt and divide is used instead
+                __m256d invR = _mm256_div_pd(one, _mm256_sqrt_pd(r2));
+
+                __m256d scale = _mm256_mul_pd(_mm256_loadu_pd(mass + j), _mm256_mul_pd(invR, _mm256_mul_pd(invR, invR)));
+                scale = _mm256_and_pd(scale, _mm256_cmp_pd(r2, zero, _CMP_GT_OQ));   // Drop coincident sources
+
+                accX = _mm256_fmadd_pd(scale, dx, accX);
+                accY = _mm256_fmadd_pd(scale, dy, accY);
+                accZ = _mm256_fmadd_pd(scale, dz, accZ);
+            }
+
+            glm::dvec3 tail = accumulateRange(x, y, z, mass, j, count, px, py, pz, eps2);
+            return glm::dvec3(horizontalSum(accX), horizontalSum(accY), horizontalSum(accZ)) + tail;
+        }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+        __attribute__((target("avx512f")))
+        static glm::dvec3 accumulateAVX512(const double* x, const double* y, const double* z, const double* mass, size_t count,
+                                           double px, double py, double pz, double eps2) {
+            const __m512d targetX = _mm512_set1_pd(px);
+            const __m512d targetY = _mm512_set1_pd(py);
+            const __m512d targetZ = _mm512_set1_pd(pz);
+            const __m512d softening = _mm512_set1_pd(eps2);
+            const __m512d half = _mm512_set1_pd(0.5);
+            const __m512d threeHalves = _mm512_set1_pd(1.5);
+            const __m512d zero = _mm512_setzero_pd();
+            __m512d accX = zero, accY = zero, accZ = zero;
+
+            size_t j = 0;
+            for (; j + 8 <= count; j += 8) {
+                __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(x + j), targetX);
+                __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(y + j), targetY);
+                __m512d dz = _mm512_sub_pd(_mm512_loadu_pd(z + j), targetZ);
+                __m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, _mm512_fmadd_pd(dz, dz, softening)));
+
+                // 14 bit estimate, two refinements bring it to full double precision
+                __m512d halfR2 = _mm512_mul_pd(half, r2);
+                __m512d invR = _mm512_rsqrt14_pd(r2);
+                invR = _mm512_mul_pd(invR, _mm512_fnmadd_pd(halfR2, _mm512_mul_pd(invR, invR), threeHalves));
+                invR = _mm512_mul_pd(invR, _mm512_fnmadd_pd(halfR2, _mm512_mul_pd(invR, invR), threeHalves));
+
+                __m512d scale = _mm512_mul_pd(_mm512_loadu_pd(mass + j), _mm512_mul_pd(invR, _mm512_mul_pd(invR, invR)));
+                __mmask8 valid = _mm512_cmp_pd_mask(r2, zero, _CMP_GT_OQ);
+
+                accX = _mm512_mask3_fmadd_pd(scale, dx, accX, valid);
+                accY = _mm512_mask3_fmadd_pd(scale, dy, accY, valid);
+                accZ = _mm512_mask3_fmadd_pd(scale, dz, accZ, valid);
+            }
+
+            glm::dvec3 tail = accumulateRange(x, y, z, mass, j, count, px, py, pz, eps2);
+            return glm::dvec3(_mm512_reduce_add_pd(accX), _mm512_reduce_add_pd(accY), _mm512_reduce_add_pd(accZ)) + tail;
+        }
+#pragma GCC diagnostic pop
+#endif
+};
+
+#endif //OPENGLPRACTICE_GRAVITYKERNEL_H
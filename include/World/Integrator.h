@@ -0,0 +1,578 @@
+/*
+ * Time integration schemes used by Simulation::simulationUpdate().
+ * An integrator advances the BodyStore by an explicit dt in seconds, asking a ForceSolver for accelerations as often as its scheme needs.
+ * The symplectic schemes (Leapfrog, Yoshida4) keep the energy error bounded instead of drifting,
+ * which allows much larger steps than the old semi-implicit Euler update for the same accuracy.
+ */
+
+#ifndef OPENGLPRACTICE_INTEGRATOR_H
+#define OPENGLPRACTICE_INTEGRATOR_H
+
+#include <vector>
+#include <cmath>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+
+#include "World/BodyStore.h"
+
+/**
+ * Per body accelerations, laid out like the BodyStore
+ */
+class Accelerations {
+    public:
+        std::vector<double> x, y, z;
+
+        size_t size() const {
+            return x.size();
+        }
+
+        void resize(size_t count) {
+            x.assign(count, 0.0);
+            y.assign(count, 0.0);
+            z.assign(count, 0.0);
+        }
+};
+
+/**
+ * Anything able to fill in the accelerations of every body in a given state, implemented by Simulation
+ */
+class ForceSolver {
+    public:
+        virtual ~ForceSolver() = default;
+        virtual void computeAccelerations(const BodyStore& state, Accelerations& out) = 0;
+
+        /**
+         * Accelerations of the listed bodies only, every other entry of out is left as it was
+         * The fallback evaluates every body, solvers able to skip work override it
+         */
+        virtual void computeAccelerations(const BodyStore& state, Accelerations& out, const std::vector<uint32_t>& targets) {
+            Accelerations all;
+            computeAccelerations(state, all);
+            if (out.size() != state.size()) {
+                out.resize(state.size());
+            }
+            for (uint32_t i : targets) {
+                out.x[i] = all.x[i];
+                out.y[i] = all.y[i];
+                out.z[i] = all.z[i];
+            }
+        }
+};
+
+enum class IntegratorType {
+    SemiImplicitEuler,
+    Leapfrog,
+    Yoshida4,
+    BlockTimestep,
+    RKF78,
+};
+
+class Integrator {
+    public:
+        virtual ~Integrator() = default;
+
+        virtual void step(BodyStore& bodies, ForceSolver& forces, double dt) = 0;
+
+        /**
+         * Forget anything cached from earlier steps, called whenever bodies are added, removed or moved from outside
+         */
+        virtual void reset() {
+
+        }
+
+        virtual const char* name() const = 0;
+
+        virtual IntegratorType type() const = 0;
+
+        /**
+         * Accelerations carried from one step into the next, nullptr for schemes that start every step from scratch
+         * Saved by checkpoints so a restored run takes exactly the same steps
+         */
+        virtual const Accelerations* carriedAccelerations() const {
+            return nullptr;
+        }
+
+        virtual void restoreCarriedAccelerations(const Accelerations&) {
+
+        }
+
+        /**
+         * Any other per body state a scheme carries between steps, flattened to doubles for checkpoints
+         */
+        virtual std::vector<double> carriedState() const {
+            return {};
+        }
+
+        virtual void restoreCarriedState(const std::vector<double>&) {
+
+        }
+
+    protected:
+        Accelerations acc;
+
+        static void kick(BodyStore& bodies, const Accelerations& acc, double dt) {
+            size_t count = bodies.size();
+            for (size_t i = 0; i < count; i++) {
+                bodies.vx[i] += acc.x[i] * dt;
+                bodies.vy[i] += acc.y[i] * dt;
+                bodies.vz[i] += acc.z[i] * dt;
+            }
+        }
+
+        static void drift(BodyStore& bodies, double dt) {
+            size_t count = bodies.size();
+            for (size_t i = 0; i < count; i++) {
+                bodies.x[i] += bodies.vx[i] * dt;
+                bodies.y[i] += bodies.vy[i] * dt;
+                bodies.z[i] += bodies.vz[i] * dt;
+            }
+        }
+};
+
+/**
+ * The original update, velocities from the current accelerations then positions from the new velocities
+ * First order and not time reversible, energy drifts steadily
+ */
+class SemiImplicitEuler : public Integrator {
+    public:
+        void step(BodyStore& bodies, ForceSolver& forces, double dt) override {
+            forces.computeAccelerations(bodies, acc);
+            kick(bodies, acc, dt);
+            drift(bodies, dt);
+        }
+
+        const char* name() const override {
+            return "euler";
+        }
+
+        IntegratorType type() const override {
+            return IntegratorType::SemiImplicitEuler;
+        }
+};
+
+/**
+ * Kick-drift-kick leapfrog (velocity Verlet), second order and symplectic
+ * The closing kick's accelerations are reused as the next step's opening kick, so it costs a single force evaluation per step
+ */
+class Leapfrog : public Integrator {
+    public:
+        void step(BodyStore& bodies, ForceSolver& forces, double dt) override {
+            if (!primed || acc.size() != bodies.size()) {
+                forces.computeAccelerations(bodies, acc);
+                primed = true;
+            }
+            kick(bodies, acc, 0.5 * dt);
+            drift(bodies, dt);
+            forces.computeAccelerations(bodies, acc);
+            kick(bodies, acc, 0.5 * dt);
+        }
+
+        void reset() override {
+            primed = false;
+        }
+
+        const char* name() const override {
+            return "leapfrog";
+        }
+
+        IntegratorType type() const override {
+            return IntegratorType::Leapfrog;
+        }
+
+        const Accelerations* carriedAccelerations() const override {
+            return primed ? &acc : nullptr;
+        }
+
+        void restoreCarriedAccelerations(const Accelerations& carried) override {
+            acc = carried;
+            primed = true;
+        }
+
+    private:
+        bool primed = false;
+};
+
+/**
+ * Fourth order symplectic scheme of Yoshida / Forest-Ruth, three leapfrog substeps with weights w1, w0, w1
+ * Costs three force evaluations per step but the error falls with dt^4
+ */
+class Yoshida4 : public Integrator {
+    public:
+        void step(BodyStore& bodies, ForceSolver& forces, double dt) override {
+            const double cubeRoot2 = std::cbrt(2.0);
+            const double w1 = 1.0 / (2.0 - cubeRoot2);
+            const double w0 = -cubeRoot2 / (2.0 - cubeRoot2);
+            const double c[4] = { 0.5 * w1, 0.5 * (w0 + w1), 0.5 * (w0 + w1), 0.5 * w1 };
+            const double d[3] = { w1, w0, w1 };
+
+            for (int k = 0; k < 3; k++) {
+                drift(bodies, c[k] * dt);
+                forces.computeAccelerations(bodies, acc);
+                kick(bodies, acc, d[k] * dt);
+            }
+            drift(bodies, c[3] * dt);
+        }
+
+        const char* name() const override {
+            return "yoshida4";
+        }
+
+        IntegratorType type() const override {
+            return IntegratorType::Yoshida4;
+        }
+};
+
+/**
+ * Kick-drift-kick leapfrog with hierarchical power-of-two block timesteps
+ * dt is the coarsest step (rung 0), a body on rung r steps by dt / 2^r and only gets its acceleration evaluated at the end of
+ * its own steps, while every body drifts between those events. Rungs come from the acceleration / jerk criterion
+ * eta * |a| / |da/dt|, the jerk being the change of acceleration over the body's previous step.
+ * A body moves to a finer rung whenever it needs to, and to a coarser one a rung at a time where the coarser step lines up.
+ * All bodies are synchronized again at the end of every step(), so outputs and energies see one consistent state.
+ */
+class BlockTimestep : public Integrator {
+    public:
+        int maxRung = 10;       // Finest step is dt / 2^maxRung
+        double eta = 0.02;      // Accuracy parameter, the fraction of a / jerk a body may step
+
+        void step(BodyStore& bodies, ForceSolver& forces, double dt) override {
+            size_t count = bodies.size();
+            if (!primed || acc.size() != count || rung.size() != count) {
+                prime(bodies, forces, dt);
+            }
+
+            const uint64_t ticks = uint64_t(1) << maxRung;
+            const double tick = dt / ticks;
+            stepStart.assign(count, 0);
+
+            // Opening half kicks, every body starts a step at tick 0
+            for (size_t i = 0; i < count; i++) {
+                kickBody(bodies, i, 0.5 * stepLength(i, dt));
+            }
+
+            uint64_t now = 0;
+            while (now < ticks) {
+                // Next tick at which any body's step ends
+                uint64_t next = ticks;
+                for (size_t i = 0; i < count; i++) {
+                    next = std::min(next, stepStart[i] + stepTicks(i));
+                }
+                drift(bodies, (next - now) * tick);
+                now = next;
+
+                active.clear();
+                for (size_t i = 0; i < count; i++) {
+                    if (stepStart[i] + stepTicks(i) == now) {
+                        active.push_back(static_cast<uint32_t>(i));
+                    }
+                }
+                startAcc.resize(active.size());
+                for (size_t k = 0; k < active.size(); k++) {
+                    uint32_t i = active[k];
+                    startAcc[k] = glm::dvec3(acc.x[i], acc.y[i], acc.z[i]);
+                }
+                forces.computeAccelerations(bodies, acc, active);
+
+                for (size_t k = 0; k < active.size(); k++) {
+                    uint32_t i = active[k];
+                    double length = stepLength(i, dt);
+                    kickBody(bodies, i, 0.5 * length);
+
+                    glm::dvec3 a(acc.x[i], acc.y[i], acc.z[i]);
+                    rung[i] = nextRung(rung[i], desiredRung(a, (a - startAcc[k]) / length, dt), now);
+                    stepStart[i] = now;
+                    // Bodies carrying on inside this step get their opening kick now, the rest get it at the next step()
+                    if (now < ticks) {
+                        kickBody(bodies, i, 0.5 * stepLength(i, dt));
+                    }
+                }
+            }
+        }
+
+        void reset() override {
+            primed = false;
+        }
+
+        const char* name() const override {
+            return "block";
+        }
+
+        IntegratorType type() const override {
+            return IntegratorType::BlockTimestep;
+        }
+
+        const Accelerations* carriedAccelerations() const override {
+            return primed ? &acc : nullptr;
+        }
+
+        void restoreCarriedAccelerations(const Accelerations& carried) override {
+            acc = carried;
+        }
+
+        std::vector<double> carriedState() const override {
+            return std::vector<double>(rung.begin(), rung.end());
+        }
+
+        void restoreCarriedState(const std::vector<double>& state) override {
+            rung.assign(state.begin(), state.end());
+            primed = !rung.empty() && rung.size() == acc.size();
+        }
+
+        /**
+         * Number of bodies on each rung after the last step, index 0 is the coarsest
+         */
+        std::vector<size_t> rungOccupancy() const {
+            std::vector<size_t> occupancy(maxRung + 1, 0);
+            for (int r : rung) {
+                occupancy[r]++;
+            }
+            return occupancy;
+        }
+
+    private:
+        bool primed = false;
+        std::vector<int> rung;
+        std::vector<uint64_t> stepStart;    // Tick at which each body's current step began
+        std::vector<uint32_t> active;
+        std::vector<glm::dvec3> startAcc;
+
+        uint64_t stepTicks(size_t i) const {
+            return uint64_t(1) << (maxRung - rung[i]);
+        }
+
+        double stepLength(size_t i, double dt) const {
+            return std::ldexp(dt, -rung[i]);
+        }
+
+        void kickBody(BodyStore& bodies, size_t i, double dt) const {
+            bodies.vx[i] += acc.x[i] * dt;
+            bodies.vy[i] += acc.y[i] * dt;
+            bodies.vz[i] += acc.z[i] * dt;
+        }
+
+        /**
+         * Finest rung whose step is within eta * |a| / |jerk|
+         */
+        int desiredRung(glm::dvec3 a, glm::dvec3 jerk, double dt) const {
+            double jerkLength = glm::length(jerk);
+            if (jerkLength == 0.0) return 0;
+            double wanted = eta * glm::length(a) / jerkLength;
+            if (wanted >= dt) return 0;
+            return std::clamp(static_cast<int>(std::ceil(std::log2(dt / wanted))), 0, maxRung);
+        }
+
+        /**
+         * Finer rungs always line up with the current tick, coarser ones only where their step boundary falls on it
+         */
+        int nextRung(int current, int desired, uint64_t now) const {
+            if (desired >= current) return desired;
+            int coarser = current - 1;
+            return now % (uint64_t(1) << (maxRung - coarser)) == 0 ? coarser : current;
+        }
+
+        /**
+         * First accelerations and rungs, the initial jerk comes from a second evaluation one finest step along every velocity
+         */
+        void prime(const BodyStore& bodies, ForceSolver& forces, double dt) {
+            size_t count = bodies.size();
+            forces.computeAccelerations(bodies, acc);
+
+            double probe = std::ldexp(dt, -maxRung);
+            BodyStore ahead = bodies;
+            drift(ahead, probe);
+            Accelerations later;
+            forces.computeAccelerations(ahead, later);
+
+            rung.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                glm::dvec3 a(acc.x[i], acc.y[i], acc.z[i]);
+                glm::dvec3 jerk = (glm::dvec3(later.x[i], later.y[i], later.z[i]) - a) / probe;
+                rung[i] = desiredRung(a, jerk, dt);
+            }
+            primed = true;
+        }
+};
+
+/**
+ * Runge-Kutta-Fehlberg 7(8) with adaptive substeps, for close encounters and long term studies that need near machine precision
+ * Each step() covers exactly dt with as many substeps as the error estimate demands, and the last accepted substep size is
+ * carried into the next call, so quiet stretches are crossed in a few large substeps while a close approach is resolved finely.
+ * The 8th order solution is propagated and the difference to the embedded 7th order one, 41/840 h (k0 + k10 - k11 - k12),
+ * is held below tolerance relative to each body's position and velocity. 13 force evaluations per substep.
+ */
+class RKF78 : public Integrator {
+    public:
+        double tolerance = 1e-13;   // Allowed local error per substep, relative to |x| + h|v| and |v| + h|a| of each body
+        double minSubstep = 1e-3;   // Seconds, substeps are never forced below this even when the error says so
+
+        void step(BodyStore& bodies, ForceSolver& forces, double dt) override {
+            if (substep <= 0.0) {
+                substep = dt;
+            }
+
+            double done = 0.0;
+            while (done < dt) {
+                double h = std::min(substep, dt - done);
+                bool last = h == dt - done;
+                double error = attempt(bodies, forces, h);
+                double factor = std::clamp(0.9 * std::pow(std::max(error, 1e-30), -1.0 / 8.0), 0.2, 5.0);
+
+                if (error <= 1.0 || h <= minSubstep) {
+                    accept(bodies);
+                    done = last ? dt : done + h;
+                    // A substep shortened to land on dt says nothing about how large the next one may be
+                    if (!last || factor < 1.0) {
+                        substep = h * factor;
+                    }
+                }
+                else {
+                    substep = std::max(h * factor, minSubstep);
+                }
+            }
+        }
+
+        void reset() override {
+            substep = 0.0;
+        }
+
+        const char* name() const override {
+            return "rkf78";
+        }
+
+        IntegratorType type() const override {
+            return IntegratorType::RKF78;
+        }
+
+        std::vector<double> carriedState() const override {
+            return { substep };
+        }
+
+        void restoreCarriedState(const std::vector<double>& state) override {
+            substep = state.empty() ? 0.0 : state[0];
+        }
+
+        /**
+         * Size of the substep the next step() will try first
+         */
+        double nextSubstep() const {
+            return substep;
+        }
+
+    private:
+        static constexpr int stages = 13;
+
+        double substep = 0.0;
+        BodyStore trial;
+        Accelerations stageVelocity[stages], stageAcceleration[stages];
+        Accelerations nextPosition, nextVelocity;
+
+        // Fehlberg's coefficients, NASA TR R-287
+        static constexpr double a[stages][stages - 1] = {
+            {},
+            { 2.0 / 27.0 },
+            { 1.0 / 36.0, 1.0 / 12.0 },
+            { 1.0 / 24.0, 0.0, 1.0 / 8.0 },
+            { 5.0 / 12.0, 0.0, -25.0 / 16.0, 25.0 / 16.0 },
+            { 1.0 / 20.0, 0.0, 0.0, 1.0 / 4.0, 1.0 / 5.0 },
+            { -25.0 / 108.0, 0.0, 0.0, 125.0 / 108.0, -65.0 / 27.0, 125.0 / 54.0 },
+            { 31.0 / 300.0, 0.0, 0.0, 0.0, 61.0 / 225.0, -2.0 / 9.0, 13.0 / 900.0 },
+            { 2.0, 0.0, 0.0, -53.0 / 6.0, 704.0 / 45.0, -107.0 / 9.0, 67.0 / 90.0, 3.0 },
+            { -91.0 / 108.0, 0.0, 0.0, 23.0 / 108.0, -976.0 / 135.0, 311.0 / 54.0, -19.0 / 60.0, 17.0 / 6.0, -1.0 / 12.0 },
+            { 2383.0 / 4100.0, 0.0, 0.0, -341.0 / 164.0, 4496.0 / 1025.0, -301.0 / 82.0, 2133.0 / 4100.0, 45.0 / 82.0, 45.0 / 164.0, 18.0 / 41.0 },
+            { 3.0 / 205.0, 0.0, 0.0, 0.0, 0.0, -6.0 / 41.0, -3.0 / 205.0, -3.0 / 41.0, 3.0 / 41.0, 6.0 / 41.0, 0.0 },
+            { -1777.0 / 4100.0, 0.0, 0.0, -341.0 / 164.0, 4496.0 / 1025.0, -289.0 / 82.0, 2193.0 / 4100.0, 51.0 / 82.0, 33.0 / 164.0, 12.0 / 41.0, 0.0, 1.0 },
+        };
+        static constexpr double b8[stages] = { 0.0, 0.0, 0.0, 0.0, 0.0, 34.0 / 105.0, 9.0 / 35.0, 9.0 / 35.0, 9.0 / 280.0, 9.0 / 280.0, 0.0, 41.0 / 840.0, 41.0 / 840.0 };
+        static constexpr double errorWeight = 41.0 / 840.0;
+
+        /**
+         * Runs all stages of a substep of length h from bodies, leaving the 8th order result in nextPosition / nextVelocity
+         * @return The largest scaled error over all bodies, at most 1 when the substep is acceptable
+         */
+        double attempt(const BodyStore& bodies, ForceSolver& forces, double h) {
+            size_t count = bodies.size();
+            trial = bodies;
+
+            for (int s = 0; s < stages; s++) {
+                Accelerations& velocity = stageVelocity[s];
+                velocity.resize(count);
+                for (size_t i = 0; i < count; i++) {
+                    double x = bodies.x[i], y = bodies.y[i], z = bodies.z[i];
+                    double vx = bodies.vx[i], vy = bodies.vy[i], vz = bodies.vz[i];
+                    for (int j = 0; j < s; j++) {
+                        double w = h * a[s][j];
+                        if (w == 0.0) continue;
+                        x += w * stageVelocity[j].x[i];
+                        y += w * stageVelocity[j].y[i];
+                        z += w * stageVelocity[j].z[i];
+                        vx += w * stageAcceleration[j].x[i];
+                        vy += w * stageAcceleration[j].y[i];
+                        vz += w * stageAcceleration[j].z[i];
+                    }
+                    trial.x[i] = x;
+                    trial.y[i] = y;
+                    trial.z[i] = z;
+                    velocity.x[i] = vx;
+                    velocity.y[i] = vy;
+                    velocity.z[i] = vz;
+                }
+                forces.computeAccelerations(trial, stageAcceleration[s]);
+            }
+
+            nextPosition.resize(count);
+            nextVelocity.resize(count);
+            double error = 0.0;
+            for (size_t i = 0; i < count; i++) {
+                glm::dvec3 dx(0.0), dv(0.0);
+                for (int s = 0; s < stages; s++) {
+                    if (b8[s] == 0.0) continue;
+                    dx += b8[s] * stageVec(stageVelocity[s], i);
+                    dv += b8[s] * stageVec(stageAcceleration[s], i);
+                }
+                glm::dvec3 x = bodies.position(i) + h * dx;
+                glm::dvec3 v = bodies.velocity(i) + h * dv;
+                nextPosition.x[i] = x.x;
+                nextPosition.y[i] = x.y;
+                nextPosition.z[i] = x.z;
+                nextVelocity.x[i] = v.x;
+                nextVelocity.y[i] = v.y;
+                nextVelocity.z[i] = v.z;
+
+                glm::dvec3 positionError = errorWeight * h * (stageVec(stageVelocity[0], i) + stageVec(stageVelocity[10], i)
+                                                             - stageVec(stageVelocity[11], i) - stageVec(stageVelocity[12], i));
+                glm::dvec3 velocityError = errorWeight * h * (stageVec(stageAcceleration[0], i) + stageVec(stageAcceleration[10], i)
+                                                             - stageVec(stageAcceleration[11], i) - stageVec(stageAcceleration[12], i));
+                double positionScale = glm::length(bodies.position(i)) + h * glm::length(bodies.velocity(i));
+                double velocityScale = glm::length(bodies.velocity(i)) + h * glm::length(stageVec(stageAcceleration[0], i));
+                if (positionScale > 0.0) error = std::max(error, glm::length(positionError) / (tolerance * positionScale));
+                if (velocityScale > 0.0) error = std::max(error, glm::length(velocityError) / (tolerance * velocityScale));
+            }
+            return error;
+        }
+
+        void accept(BodyStore& bodies) const {
+            bodies.x = nextPosition.x;
+            bodies.y = nextPosition.y;
+            bodies.z = nextPosition.z;
+            bodies.vx = nextVelocity.x;
+            bodies.vy = nextVelocity.y;
+            bodies.vz = nextVelocity.z;
+        }
+
+        static glm::dvec3 stageVec(const Accelerations& stage, size_t i) {
+            return glm::dvec3(stage.x[i], stage.y[i], stage.z[i]);
+        }
+};
+
+inline std::unique_ptr<Integrator> makeIntegrator(IntegratorType type) {
+    switch (type) {
+        case IntegratorType::SemiImplicitEuler: return std::make_unique<SemiImplicitEuler>();
+        case IntegratorType::Yoshida4: return std::make_unique<Yoshida4>();
+        case IntegratorType::BlockTimestep: return std::make_unique<BlockTimestep>();
+        case IntegratorType::RKF78: return std::make_unique<RKF78>();
+        default: return std::make_unique<Leapfrog>();
+    }
+}
+
+#endif //OPENGLPRACTICE_INTEGRATOR_H
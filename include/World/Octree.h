@@ -0,0 +1,204 @@
+/*
+ * Barnes-Hut octree used as an alternative to the brute force O(N^2) gravity loop.
+ * Bodies are bucketed into leaves by recursively splitting the bounding cube into octants.
+ * Every node stores the total mass, center of mass and the tight bounding box of the bodies beneath it,
+ * so distant groups of bodies can be approximated as a single point mass.
+ */
+
+#ifndef OPENGLPRACTICE_OCTREE_H
+#define OPENGLPRACTICE_OCTREE_H
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "World/BodyStore.h"
+
+class Octree {
+    public:
+        struct Node {
+            glm::dvec3 boxMin;      // Tight bounds of the bodies contained in this node
+            glm::dvec3 boxMax;
+            glm::dvec3 centerOfMass;
+            double mass;
+            double size;            // Longest edge of the bounds, used by the opening criterion
+            int firstChild;         // Index of the first of 8 contiguous children, -1 for a leaf
+            int bodyStart;          // Range of bodyIndices owned by this node
+            int bodyCount;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<int> bodyIndices;
+
+        int leafCapacity = 8;
+        int maxDepth = 32;
+
+        /**
+         * Rebuild the tree topology from scratch over the given bodies
+         * Bodies are partitioned in place inside bodyIndices, so every node owns a contiguous range of it
+         */
+        void build(const BodyStore& bodies) {
+            int count = static_cast<int>(bodies.size());
+            nodes.clear();
+            bodyIndices.resize(count);
+            scratch.resize(count);
+            for (int i = 0; i < count; i++) {
+                bodyIndices[i] = i;
+            }
+            if (count == 0) return;
+
+            glm::dvec3 lo = bodies.position(0);
+            glm::dvec3 hi = lo;
+            for (int i = 1; i < count; i++) {
+                lo = glm::min(lo, bodies.position(i));
+                hi = glm::max(hi, bodies.position(i));
+            }
+            glm::dvec3 extent = hi - lo;
+            double halfSize = 0.5 * std::max(extent.x, std::max(extent.y, extent.z));
+
+            nodes.push_back(Node{});
+            subdivide(0, 0, count, 0.5 * (lo + hi), halfSize, 0, bodies);
+            refit(bodies);
+        }
+
+        /**
+         * Recompute masses, centers of mass and bounds of every node from the current positions
+         * while keeping the existing topology. Cheaper than build() and accurate as long as the
+         * bodies haven't moved far since the last rebuild, since the opening criterion uses the refitted bounds.
+         */
+        void refit(const BodyStore& bodies) {
+            // Children are always appended after their parent, so a reverse sweep is bottom-up
+            for (int n = static_cast<int>(nodes.size()) - 1; n >= 0; n--) {
+                Node& node = nodes[n];
+                node.mass = 0.0;
+                glm::dvec3 weighted(0.0);
+                node.boxMin = glm::dvec3(std::numeric_limits<double>::max());
+                node.boxMax = glm::dvec3(-std::numeric_limits<double>::max());
+
+                if (node.firstChild < 0) {
+                    for (int k = node.bodyStart; k < node.bodyStart + node.bodyCount; k++) {
+                        int b = bodyIndices[k];
+                        glm::dvec3 p = bodies.position(b);
+                        node.mass += bodies.mass[b];
+                        weighted += bodies.mass[b] * p;
+                        node.boxMin = glm::min(node.boxMin, p);
+                        node.boxMax = glm::max(node.boxMax, p);
+                    }
+                }
+                else {
+                    for (int c = node.firstChild; c < node.firstChild + 8; c++) {
+                        const Node& child = nodes[c];
+                        if (child.bodyCount == 0) continue;
+                        node.mass += child.mass;
+                        weighted += child.mass * child.centerOfMass;
+                        node.boxMin = glm::min(node.boxMin, child.boxMin);
+                        node.boxMax = glm::max(node.boxMax, child.boxMax);
+                    }
+                }
+
+                if (node.bodyCount == 0) {
+                    node.centerOfMass = glm::dvec3(0.0);
+                    node.size = 0.0;
+                    continue;
+                }
+                node.centerOfMass = node.mass > 0.0 ? weighted / node.mass : 0.5 * (node.boxMin + node.boxMax);
+                glm::dvec3 edge = node.boxMax - node.boxMin;
+                node.size = std::max(edge.x, std::max(edge.y, edge.z));
+            }
+        }
+
+        /**
+         * Walk the tree and sum the gravitational acceleration acting on a single body
+         * A node is treated as a point mass when size / distance < theta and the target lies outside its bounds,
+         * otherwise it is opened. Leaves are summed exactly, using the same softening as the direct GravityKernel.
+         */
+        glm::dvec3 acceleration(int target, const BodyStore& bodies, double G, double theta, double softening) const {
+            glm::dvec3 acc(0.0);
+            const double eps2 = softening * softening;
+            if (nodes.empty()) return acc;
+
+            const glm::dvec3 pos = bodies.position(target);
+            std::array<int, 8 * 64> stack;
+            int top = 0;
+            stack[top++] = 0;
+
+            while (top > 0) {
+                const Node& node = nodes[stack[--top]];
+                if (node.bodyCount == 0) continue;
+
+                glm::dvec3 diff = node.centerOfMass - pos;
+                double dist2 = glm::dot(diff, diff);
+                double dist = std::sqrt(dist2);
+                bool inside = glm::all(glm::greaterThanEqual(pos, node.boxMin)) && glm::all(glm::lessThanEqual(pos, node.boxMax));
+
+                if (!inside && node.size < theta * dist) {
+                    double invR = 1.0 / std::sqrt(dist2 + eps2);
+                    acc += (G * node.mass * invR * invR * invR) * diff;
+                }
+                else if (node.firstChild >= 0) {
+                    for (int c = node.firstChild; c < node.firstChild + 8; c++) {
+                        stack[top++] = c;
+                    }
+                }
+                else {
+                    for (int k = node.bodyStart; k < node.bodyStart + node.bodyCount; k++) {
+                        int b = bodyIndices[k];
+                        if (b == target) continue;
+
+                        glm::dvec3 d = bodies.position(b) - pos;
+                        double r2 = glm::dot(d, d) + eps2;
+                        if (r2 <= 0.0) continue;
+                        double invR = 1.0 / std::sqrt(r2);
+                        acc += (G * bodies.mass[b] * invR * invR * invR) * d;
+                    }
+                }
+            }
+            return acc;
+        }
+
+    private:
+        std::vector<int> scratch;
+
+        void subdivide(int nodeIndex, int start, int count, glm::dvec3 center, double halfSize, int depth, const BodyStore& bodies) {
+            nodes[nodeIndex].bodyStart = start;
+            nodes[nodeIndex].bodyCount = count;
+            nodes[nodeIndex].firstChild = -1;
+            if (count <= leafCapacity || depth >= maxDepth || halfSize <= 0.0) return;
+
+            // Counting sort of this node's bodies by octant
+            std::array<int, 8> octantCount{};
+            for (int k = start; k < start + count; k++) {
+                octantCount[octantOf(bodies.position(bodyIndices[k]), center)]++;
+            }
+            std::array<int, 8> octantStart{};
+            for (int o = 1; o < 8; o++) {
+                octantStart[o] = octantStart[o - 1] + octantCount[o - 1];
+            }
+            std::array<int, 8> cursor = octantStart;
+            for (int k = start; k < start + count; k++) {
+                int b = bodyIndices[k];
+                scratch[start + cursor[octantOf(bodies.position(b), center)]++] = b;
+            }
+            std::copy(scratch.begin() + start, scratch.begin() + start + count, bodyIndices.begin() + start);
+
+            int firstChild = static_cast<int>(nodes.size());
+            nodes[nodeIndex].firstChild = firstChild;
+            nodes.resize(nodes.size() + 8);
+
+            double childHalf = 0.5 * halfSize;
+            for (int o = 0; o < 8; o++) {
+                glm::dvec3 offset((o & 1) ? childHalf : -childHalf, (o & 2) ? childHalf : -childHalf, (o & 4) ? childHalf : -childHalf);
+                subdivide(firstChild + o, start + octantStart[o], octantCount[o], center + offset, childHalf, depth + 1, bodies);
+            }
+        }
+
+        static int octantOf(const glm::dvec3& p, const glm::dvec3& center) {
+            return (p.x >= center.x ? 1 : 0) | (p.y >= center.y ? 2 : 0) | (p.z >= center.z ? 4 : 0);
+        }
+};
+
+#endif //OPENGLPRACTICE_OCTREE_H
@@ -7,8 +7,8 @@
 
 class Planet : public CelestialObject {
     public:
-        Planet(glm::vec3 position, glm::vec3 velocity, int segments, float mass, float radius, float pollTime, float trailDuration, glm::vec3 color) :
-            CelestialObject(position, velocity, segments, mass, radius, pollTime, trailDuration, color)
+        Planet(glm::dvec3 position, glm::dvec3 velocity, double mass, double radius, glm::vec3 color) :
+            CelestialObject(position, velocity, mass, radius, color)
         {
 
         }
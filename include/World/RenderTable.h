@@ -0,0 +1,126 @@
+/*
+ * Side table holding the render-only data of every body, indexed the same way as the BodyStore.
+ * Kept apart from the physical state so the simulation loops never pull colors, trails or GL handles into cache.
+ */
+
+#ifndef OPENGLPRACTICE_RENDERTABLE_H
+#define OPENGLPRACTICE_RENDERTABLE_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Data Structs/TrailBuffer.h"
+#include "World/SimulationSnapshot.h"
+#include "Util/Profiler.h"
+
+class RenderTable {
+    public:
+        std::vector<glm::vec3> colors;
+        std::vector<TrailBuffer> trails;
+        std::vector<uint32_t> ids;  // Body id of every entry, matched against snapshots by sync()
+        uint64_t topology = 0;
+
+        // Per body trail buffers, filled in by Renderer::bufferObjects()
+        std::vector<unsigned int> trail_VBO, trail_VAO;
+        // TrailBuffer::totalAdded() as of each bodies last upload, only points past it are sent to the GPU
+        std::vector<uint64_t> trail_uploaded;
+        // Handles of removed bodies, deleted by Renderer::bufferObjects() on the GL thread
+        std::vector<unsigned int> retired_VBO, retired_VAO;
+
+        float pollTime;
+        float trailDuration;
+
+        RenderTable(float pollTime, float trailDuration) {
+            this->pollTime = pollTime;
+            this->trailDuration = trailDuration;
+        }
+
+        size_t size() const {
+            return colors.size();
+        }
+
+        void reserve(size_t count) {
+            colors.reserve(count);
+            trails.reserve(count);
+            ids.reserve(count);
+        }
+
+        void clear() {
+            colors.clear();
+            trails.clear();
+            ids.clear();
+        }
+
+        void add(glm::vec3 color, uint32_t id) {
+            colors.push_back(color);
+            trails.emplace_back(pollTime, trailDuration);
+            ids.push_back(id);
+        }
+
+        /**
+         * Drops the entries of bodies that are no longer in the snapshot, after collisions merged them away
+         * Both sides keep their bodies in id order, so one merge-style pass lines them up again
+         * Runs on the render thread, the simulation never touches the render table while it is stepping
+         */
+        void sync(const SimulationSnapshot& snapshot) {
+            if (snapshot.ids.empty()) return;
+            sync(snapshot.ids, snapshot.topology);
+        }
+
+        /**
+         * Same as above for callers holding the simulation itself, bodyIds is BodyStore::ids
+         */
+        void sync(const std::vector<uint32_t>& bodyIds, uint64_t bodyTopology) {
+            if (bodyTopology == topology) return;
+
+            size_t kept = 0;
+            size_t next = 0;
+            for (size_t i = 0; i < ids.size(); i++) {
+                bool alive = next < bodyIds.size() && bodyIds[next] == ids[i];
+                if (!alive) {
+                    if (i < trail_VBO.size()) {
+                        retired_VBO.push_back(trail_VBO[i]);
+                        retired_VAO.push_back(trail_VAO[i]);
+                    }
+                    continue;
+                }
+                next++;
+                if (kept != i) {
+                    colors[kept] = colors[i];
+                    std::swap(trails[kept], trails[i]);
+                    ids[kept] = ids[i];
+                    if (i < trail_VBO.size()) {
+                        trail_VBO[kept] = trail_VBO[i];
+                        trail_VAO[kept] = trail_VAO[i];
+                        trail_uploaded[kept] = trail_uploaded[i];
+                    }
+                }
+                kept++;
+            }
+            size_t buffered = std::min(kept, trail_VBO.size());
+            colors.resize(kept);
+            trails.erase(trails.begin() + kept, trails.end());
+            ids.resize(kept);
+            trail_VBO.resize(buffered);
+            trail_VAO.resize(buffered);
+            trail_uploaded.resize(buffered);
+            topology = bodyTopology;
+        }
+
+        /**
+         * Method for adding a trail point to each body from a simulation snapshot
+         * Logged point is the bodies position at the time of the snapshot
+         */
+        void logTrailPoints(const SimulationSnapshot& snapshot) {
+            PROFILE_SCOPE("trail log");
+            size_t count = std::min(snapshot.size(), trails.size());
+            for (size_t i = 0; i < count; i++) {
+                trails[i].addTrailPoint(glm::vec3(snapshot.positions[i]));
+            }
+        }
+};
+
+#endif //OPENGLPRACTICE_RENDERTABLE_H
@@ -2,97 +2,313 @@
 #define OPENGLPRACTICE_SIMULATION_H
 
 #include <vector>
-#include <memory>
 #include <fstream>
+#include <cmath>
+#include <memory>
+#include <cstdint>
 
 #include <json.hpp>
 using json = nlohmann::json;
 
 #include "Planet.h"
 #include "Star.h"
+#include "BodyStore.h"
+#include "RenderTable.h"
+#include "SimulationSnapshot.h"
+#include "Octree.h"
+#include "GravityKernel.h"
+#include "Integrator.h"
+#include "Collisions.h"
 #include "Graphics/Colors.h"
+#include "IO/ScenarioLoader.h"
+#include "Util/ThreadPool.h"
+#include "Util/Profiler.h"
+
+/**
+ * Selects how the gravitational acceleration of every object is evaluated each update
+ * Direct compares every object against every other object, BarnesHut approximates distant groups through an Octree
+ */
+enum class ForceMethod {
+    Direct,
+    BarnesHut,
+};
 
 /**
  * Simulation implementation that supports a single star and many planets.
  * The star is in a static position.
  * Each planet only calculates it's rgavitational force from the star.
  */
-class Simulation {
+class Simulation : public ForceSolver {
     public:
-        std::vector<std::unique_ptr<CelestialObject>> objects;
+        BodyStore bodies;   // Physical state, the source of truth for every update
+        RenderTable render; // Colors, trails and GL handles, indexed the same as bodies
+
+        double G = 6.6743e-11; // Newtons gravitiational constant
+
+        // Time stepping
+        double dt = 1440.0;     // Seconds advanced by every simulationUpdate()
+        double time = 0.0;      // Simulated seconds elapsed
+        uint64_t steps = 0;     // simulationUpdate() calls so far
+        uint64_t forceEvaluations = 0; // Per body acceleration evaluations so far, the cost measure integrators are compared by
+        std::unique_ptr<Integrator> integrator = makeIntegrator(IntegratorType::Leapfrog);
 
-        float G = 6.6743e-11f; // Newtons gravitiational constant
+        // Collision handling, off unless collisions.response is set
+        CollisionDetector collisions;
+        uint64_t collisionCount = 0;
+        uint64_t topology = 0;  // Incremented every time bodies are removed, lets the render table notice it must resync
 
-        Simulation() {
+        // Force evaluation settings
+        ForceMethod forceMethod = ForceMethod::Direct;
+        double softening = 1000.0; // Plummer softening length in meters, keeps overlapping bodies from slingshoting
+        GravityKernel kernel;       // Direct summation implementation, picked from the CPU features
+        float theta = 0.5f;         // Barnes-Hut opening angle, lower is more accurate
+        int treeRebuildInterval = 1; // Steps between full octree rebuilds, the tree is refit in between
+        size_t tileSize = 64;       // Targets per parallel force task
+
+        Simulation() : render(0.1f, 5.0f) {
 
         }
 
         /**
-         * Process a JSON file with object data into simulation objects automatically
+         * Appends the objects of a scenario JSON file (see IO/ScenarioLoader.h), streamed straight into the body store
+         * Throws with the offending object and field when the file doesn't match the schema, leaving the simulation as it was
          */
-        void jsonToObjects() {
-            std::ifstream jsonFile("..\\planetData\\objects.json");
-            json data = json::parse(jsonFile);
-            for (auto object : data["objects"]) {
-                double mass = object["mass"];
-                double radius = object["radius"]; radius *= 1000;
-                glm::vec3 position = glm::vec3(object["X"], object["Y"], object["Z"]); position *= 1000;
-                glm::vec3 velocity = glm::vec3(object["VX"], object["VY"], object["VZ"]); velocity *= 1000;
-                glm::vec3 color = Colors::colors.at(object["color"]);
-                // std::cout << object["name"] << std::endl
-                //     << mass << std::endl
-                //     << radius << std::endl
-                //     << position.x << ", " << position.y << ", " << position.z << std::endl
-                //     << velocity.x << ", " << velocity.y << ", " << velocity.z << std::endl << std::endl;
+        ScenarioLoadStats jsonToObjects(const std::string& path = ScenarioLoader::defaultPath) {
+            ScenarioLoadStats stats = ScenarioLoader::load(path, bodies, render);
+            integrator->reset();
+            return stats;
+        }
 
-                addObject(std::make_unique<CelestialObject>(position, velocity, 30, mass, radius, 0.1f, 5.0f, color));
+        /**
+         * Sets how many threads evaluate forces, 1 keeps everything on the calling thread
+         * Every body's acceleration is still summed by a single thread in the same order, so results are bit-identical to the serial path
+         */
+        void setThreadCount(unsigned threads) {
+            if (threads <= 1) {
+                pool.reset();
+            }
+            else if (!pool || pool->threadCount() != threads) {
+                pool = std::make_unique<ThreadPool>(threads);
             }
         }
 
-        // Trade ownership of the object pointer to the array
-        void addObject(std::unique_ptr<CelestialObject> obj) {
-            objects.push_back(std::move(obj));
+        /**
+         * The force evaluation pool, nullptr when running single threaded
+         */
+        ThreadPool* threadPool() const {
+            return pool.get();
+        }
+
+        void setIntegrator(IntegratorType type) {
+            integrator = makeIntegrator(type);
+        }
+
+        // Copy the object into the body store and its color into the render table
+        void addObject(const CelestialObject& obj) {
+            bodies.add(obj.position, obj.velocity, obj.mass, obj.radius);
+            render.add(obj.color, bodies.ids.back());
+            integrator->reset();
         }
 
         /**
-         * Implementation of simulation update that calculates the gravitational force of each object on every other object
-         * This is a brute approach to the calculation, see FMM for more efficient methods for calculating a large number of objects
-         * This method take an iterative approach, since object positions cannot be updated until every objects velocity is solved
-         * TODO: Add a limit so if the planets center is closer to the object it is calculating against it doesn't calculate as to avoid slingshoting
+         * Advances every body by dt seconds with the selected integrator and force method
          */
         void simulationUpdate() {
-            // Loop for updating the velocities of each object
-            for (auto& focusObj : objects) {
-                for (auto& comparisonObj : objects) {
-                    // Check if the objects are the same, if yes skip loop
-                    if (focusObj == comparisonObj) {
-                        continue;
-                    }
-
-                    glm::vec3 position_difference = comparisonObj->position - focusObj->position;
-                    float radius = glm::length(position_difference);
-
-                    if (radius <= comparisonObj->radius + focusObj->radius) continue;
-                    glm::vec3 direction_unit_vector = position_difference / radius;
-                    glm::vec3 acceleration = (G * comparisonObj->mass * direction_unit_vector) / (radius * radius);
-
-                    focusObj->updateVelocity(acceleration);
+            PROFILE_SCOPE("step");
+            if (collisions.enabled()) {
+                collisions.beginStep(bodies);
+            }
+            {
+                // The integrator's own work, the force evaluations it makes are filed under "force"
+                PROFILE_SELF_SCOPE("integrate");
+                integrator->step(bodies, *this, dt);
+            }
+            time += dt;
+            steps++;
+            stepsSinceRebuild++;
+            if (collisions.enabled()) {
+                PROFILE_SCOPE("collisions");
+                resolveCollisions();
+            }
+        }
+
+        /**
+         * Resolves every collision of the last step and drops merged bodies
+         * Integrators cache accelerations between steps, which no longer match once velocities or bodies changed
+         */
+        void resolveCollisions() {
+            size_t before = bodies.size();
+            size_t resolved = collisions.resolve(bodies, dt);
+            if (resolved == 0) return;
+
+            collisionCount += resolved;
+            integrator->reset();
+            if (bodies.size() != before) {
+                topology++;
+                invalidateTree();
+            }
+        }
+
+        /**
+         * Fills out with the gravitational acceleration acting on every body of state at its current position
+         * state is usually bodies, but integrators may pass trial states of their own
+         */
+        void computeAccelerations(const BodyStore& state, Accelerations& out) override {
+            PROFILE_SCOPE("force");
+            out.resize(state.size());
+
+            if (forceMethod == ForceMethod::BarnesHut) {
+                computeBarnesHut(state, out);
+            }
+            else {
+                computeDirect(state, out);
+            }
+        }
+
+        /**
+         * Same as above but only the listed bodies are written, every body still acts as a source
+         */
+        void computeAccelerations(const BodyStore& state, Accelerations& out, const std::vector<uint32_t>& targets) override {
+            PROFILE_SCOPE("force");
+            if (out.size() != state.size()) {
+                out.resize(state.size());
+            }
+
+            if (forceMethod == ForceMethod::BarnesHut) {
+                computeBarnesHut(state, out, targets.data(), targets.size());
+            }
+            else {
+                computeDirect(state, out, targets.data(), targets.size());
+            }
+        }
+
+        /**
+         * Implementation of the acceleration calculation that compares each body to every other body
+         * This is a brute approach to the calculation, see computeBarnesHut() for large numbers of bodies
+         * The inner loop over every other body runs through the vectorized GravityKernel
+         * targets limits the update to targetCount listed bodies, nullptr updates every body
+         */
+        void computeDirect(const BodyStore& state, Accelerations& out, const uint32_t* targets = nullptr, size_t targetCount = 0) {
+            const double* x = state.x.data();
+            const double* y = state.y.data();
+            const double* z = state.z.data();
+            const double* mass = state.mass.data();
+            size_t count = state.size();
+            size_t updates = targets ? targetCount : count;
+            forceEvaluations += updates;
+
+            forEachTile(updates, [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; k++) {
+                    size_t i = targets ? targets[k] : k;
+                    glm::dvec3 acc = kernel.acceleration(x, y, z, mass, count, x[i], y[i], z[i], G, softening);
+                    out.x[i] = acc.x;
+                    out.y[i] = acc.y;
+                    out.z[i] = acc.z;
+                }
+            });
+        }
+
+        /**
+         * Barnes-Hut approximation of computeDirect(), O(N log N) per update
+         * The octree is rebuilt by the first evaluation of every treeRebuildInterval-th step and refit to the new positions
+         * by every other evaluation. Integrators that evaluate several times per step (Yoshida4, RKF78 substeps,
+         * BlockTimestep rungs) therefore pay one O(N) refit per evaluation, however few targets it updates,
+         * but never more than one full rebuild per step
+         */
+        void computeBarnesHut(const BodyStore& state, Accelerations& out, const uint32_t* targets = nullptr, size_t targetCount = 0) {
+            size_t count = state.size();
+            size_t updates = targets ? targetCount : count;
+            forceEvaluations += updates;
+            if (stepsSinceRebuild >= treeRebuildInterval || octree.bodyIndices.size() != count) {
+                octree.build(state);
+                stepsSinceRebuild = 0;
+            }
+            else {
+                octree.refit(state);
+            }
+
+            forEachTile(updates, [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; k++) {
+                    size_t i = targets ? targets[k] : k;
+                    glm::dvec3 acc = octree.acceleration(i, state, G, theta, softening);
+                    out.x[i] = acc.x;
+                    out.y[i] = acc.y;
+                    out.z[i] = acc.z;
+                }
+            });
+        }
+
+        /**
+         * Total kinetic plus pairwise potential energy in joules
+         * Uses the same softened potential as the force kernels, O(N^2)
+         */
+        double totalEnergy() const {
+            size_t count = bodies.size();
+            double eps2 = softening * softening;
+            double kinetic = 0.0, potential = 0.0;
+            for (size_t i = 0; i < count; i++) {
+                glm::dvec3 v = bodies.velocity(i);
+                kinetic += 0.5 * bodies.mass[i] * glm::dot(v, v);
+                for (size_t j = i + 1; j < count; j++) {
+                    glm::dvec3 d = bodies.position(j) - bodies.position(i);
+                    potential -= G * bodies.mass[i] * bodies.mass[j] / std::sqrt(glm::dot(d, d) + eps2);
                 }
             }
+            return kinetic + potential;
+        }
 
-            // Loop for updating the positions of each object after all velocities have been calculated
-            for (auto& obj : objects) {
-                obj->updatePosition();
+        /**
+         * Total angular momentum about the origin in kg m^2 / s
+         */
+        glm::dvec3 angularMomentum() const {
+            glm::dvec3 total(0.0);
+            for (size_t i = 0; i < bodies.size(); i++) {
+                total += bodies.mass[i] * glm::cross(bodies.position(i), bodies.velocity(i));
             }
+            return total;
         }
 
         /**
-         * Method for adding a trail point to each object in the simulation
-         * Logged point is the objects current position
+         * Copies the current positions and radii into a snapshot for the renderer
          */
-        void logTrailPoints() {
-            for (auto& object : objects) {
-                object->addTrailPoint();
+        void writeSnapshot(SimulationSnapshot& out) const {
+            PROFILE_SCOPE("snapshot");
+            size_t count = bodies.size();
+            out.positions.resize(count);
+            out.radii.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                out.positions[i] = bodies.position(i);
+                out.radii[i] = static_cast<float>(bodies.radius[i]);
+            }
+            out.ids = bodies.ids;
+            out.time = time;
+            out.step = steps;
+            out.topology = topology;
+        }
+
+        /**
+         * Forces the next Barnes-Hut evaluation to rebuild the octree, for when bodies were replaced wholesale
+         */
+        void invalidateTree() {
+            stepsSinceRebuild = treeRebuildInterval;
+        }
+
+    private:
+        Octree octree;
+        int stepsSinceRebuild = 0;     // simulationUpdate() calls since the octree was last built
+
+        std::unique_ptr<ThreadPool> pool;
+
+        /**
+         * Splits [0, count) into tiles of target bodies, spread over the thread pool when there is one
+         */
+        template <typename Body>
+        void forEachTile(size_t count, Body&& body) {
+            if (pool) {
+                pool->parallelFor(0, count, tileSize, body);
+            }
+            else {
+                body(0, count);
             }
         }
 
@@ -0,0 +1,28 @@
+/*
+ * Copy of everything the renderer needs from one simulation step.
+ * Snapshots are published by the SimulationThread through a TripleBuffer, so drawing never touches the live BodyStore.
+ */
+
+#ifndef OPENGLPRACTICE_SIMULATIONSNAPSHOT_H
+#define OPENGLPRACTICE_SIMULATIONSNAPSHOT_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+class SimulationSnapshot {
+    public:
+        std::vector<glm::dvec3> positions;
+        std::vector<float> radii;
+        std::vector<uint32_t> ids;  // BodyStore::ids, empty when the source has no notion of them (trajectory playback)
+        double time = 0.0;
+        uint64_t step = 0;
+        uint64_t topology = 0;      // Simulation::topology, changes whenever bodies were removed
+
+        size_t size() const {
+            return positions.size();
+        }
+};
+
+#endif //OPENGLPRACTICE_SIMULATIONSNAPSHOT_H
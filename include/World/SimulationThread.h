@@ -0,0 +1,119 @@
+/*
+ * Runs Simulation::simulationUpdate() on its own thread, decoupled from the render loop.
+ * Steps are paced by a fixed-timestep accumulator: wall clock time is converted into owed steps at stepsPerSecond,
+ * so a slow frame no longer slows the simulated clock. A rate of 0 steps as fast as the CPU allows.
+ * After every batch of steps the positions are copied into a SimulationSnapshot and published through a TripleBuffer,
+ * which the render thread picks up without locking.
+ */
+
+#ifndef OPENGLPRACTICE_SIMULATIONTHREAD_H
+#define OPENGLPRACTICE_SIMULATIONTHREAD_H
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "World/Simulation.h"
+#include "World/SimulationSnapshot.h"
+#include "Data Structs/TripleBuffer.h"
+#include "Util/Profiler.h"
+
+class SimulationThread {
+    public:
+        SimulationThread(Simulation& sim) : sim(sim) {
+
+        }
+
+        ~SimulationThread() {
+            stop();
+        }
+
+        SimulationThread(const SimulationThread&) = delete;
+        SimulationThread& operator=(const SimulationThread&) = delete;
+
+        /**
+         * Steps per wall clock second, 0 runs as fast as possible. Safe to change while running
+         */
+        void setStepsPerSecond(double rate) {
+            stepsPerSecond.store(rate, std::memory_order_relaxed);
+        }
+
+        /**
+         * Publishes the starting state and launches the thread. The simulation must not be touched from elsewhere until stop()
+         */
+        void start() {
+            if (running.load()) return;
+            publishSnapshot();
+            running.store(true);
+            worker = std::thread([this] { run(); });
+        }
+
+        void stop() {
+            running.store(false);
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+
+        /**
+         * Newest published snapshot, only to be called from the one render thread
+         */
+        const SimulationSnapshot& latestSnapshot() {
+            snapshots.update();
+            return snapshots.readBuffer();
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        Simulation& sim;
+        TripleBuffer<SimulationSnapshot> snapshots;
+        std::thread worker;
+        std::atomic<bool> running{false};
+        std::atomic<double> stepsPerSecond{60.0};
+
+        // Caps the steps owed after a stall, so a long hitch doesn't turn into a burst of catch-up work
+        const double maxOwedSteps = 1000.0;
+        // Longest stretch of uncapped stepping between snapshots
+        const std::chrono::milliseconds unlimitedBatch{4};
+
+        void run() {
+            PROFILE_THREAD("simulation");
+            double owed = 0.0;
+            Clock::time_point last = Clock::now();
+
+            while (running.load(std::memory_order_relaxed)) {
+                double rate = stepsPerSecond.load(std::memory_order_relaxed);
+                Clock::time_point now = Clock::now();
+
+                if (rate <= 0.0) {
+                    Clock::time_point batchEnd = now + unlimitedBatch;
+                    do {
+                        sim.simulationUpdate();
+                    } while (Clock::now() < batchEnd);
+                    owed = 0.0;
+                }
+                else {
+                    owed = std::min(owed + std::chrono::duration<double>(now - last).count() * rate, maxOwedSteps);
+                    if (owed < 1.0) {
+                        last = now;
+                        std::this_thread::sleep_for(std::chrono::duration<double>((1.0 - owed) / rate));
+                        continue;
+                    }
+                    for (; owed >= 1.0; owed -= 1.0) {
+                        sim.simulationUpdate();
+                    }
+                }
+                last = now;
+                publishSnapshot();
+            }
+        }
+
+        void publishSnapshot() {
+            sim.writeSnapshot(snapshots.writeBuffer());
+            snapshots.publish();
+        }
+};
+
+#endif //OPENGLPRACTICE_SIMULATIONTHREAD_H
@@ -9,8 +9,8 @@
 
 class Star : public CelestialObject {
     public:
-        Star(glm::vec3 position, glm::vec3 velocity, int segments, float mass, float radius, float pollTime, float trailDuration, glm::vec3 color) :
-            CelestialObject(position, velocity, segments, mass, radius, pollTime, trailDuration, color)
+        Star(glm::dvec3 position, glm::dvec3 velocity, double mass, double radius, glm::vec3 color) :
+            CelestialObject(position, velocity, mass, radius, color)
         {
 
         }
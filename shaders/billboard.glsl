@@ -1,14 +1,41 @@
 #version 330
 
 layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec3 instancePosition; // World space position of the body, one per instance
+layout (location = 3) in vec3 instanceColor;
 
 uniform mat4 ortho; // View matrix equivalent
-uniform mat4 screenPosition; // Model matrix equivalent
-uniform vec3 color;
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 cameraPos;
+uniform float zoomFactor;
+uniform vec2 screenSize;
+uniform float billboardSize;
 
 out vec3 vertColor;
 
+// Outside the clip volume, every vertex of a culled billboard goes here so the whole fan is discarded before rasterization
+const vec4 culled = vec4(0.0, 0.0, 2.0, 1.0);
+
 void main() {
-    gl_Position = ortho * screenPosition * vec4(aPos, 0.0f, 1.0f);
-    vertColor = color;
+    vec3 relative = instancePosition - cameraPos;
+    float r = length(relative);
+    vec3 compressed = r > 0.0 ? relative * (sqrt(r) * zoomFactor / r) : relative;
+
+    vec4 clip = projection * view * vec4(compressed, 1.0);
+    vertColor = instanceColor;
+    if (clip.w <= 0.0) {
+        // Behind the camera
+        gl_Position = culled;
+        return;
+    }
+
+    vec2 ndc = clip.xy / clip.w;
+    vec2 screen = vec2((ndc.x + 1.0) * 0.5 * screenSize.x, (1.0 - ndc.y) * 0.5 * screenSize.y);
+    if (any(lessThan(screen, vec2(-billboardSize))) || any(greaterThan(screen, screenSize + billboardSize))) {
+        // Off screen, the decision depends only on the instance so all its vertices agree
+        gl_Position = culled;
+        return;
+    }
+    gl_Position = ortho * vec4(screen + aPos * billboardSize, 0.0, 1.0);
 }
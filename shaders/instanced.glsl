@@ -0,0 +1,25 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 instancePosition;    // World space position
+layout (location = 2) in float instanceRadius;     // World space radius
+layout (location = 3) in vec3 instanceColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// Distance compression, the same square root scaling vertex.glsl applies to trails
+uniform vec3 cameraPos;
+uniform float zoomFactor;
+
+out vec3 vertColor;
+
+void main() {
+    vec3 relative = instancePosition - cameraPos;
+    float r = length(relative);
+    vec3 compressed = r > 0.0 ? relative * (sqrt(r) * zoomFactor / r) : relative;
+    float scale = sqrt(instanceRadius) * zoomFactor;
+
+    gl_Position = projection * view * vec4(aPos * scale + compressed, 1.0);
+    vertColor = instanceColor;
+}
@@ -7,9 +7,17 @@ uniform mat4 view;
 uniform mat4 projection;
 uniform vec3 color;
 
+// Distance compression, positions arrive in world space and are pulled in by the square root of their camera distance
+uniform vec3 cameraPos;
+uniform float zoomFactor;
+
 out vec3 vertColor;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 relative = (model * vec4(aPos, 1.0)).xyz - cameraPos;
+    float r = length(relative);
+    vec3 compressed = r > 0.0 ? relative * (sqrt(r) * zoomFactor / r) : relative;
+
+    gl_Position = projection * view * vec4(compressed, 1.0);
     vertColor = color;
 }
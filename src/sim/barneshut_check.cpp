@@ -0,0 +1,64 @@
+/*
+ * Accuracy check of the Barnes-Hut force method against the direct sum.
+ * Loads a scenario, evaluates every body's acceleration with computeDirect() and computeBarnesHut() from the same state
+ * and prints the largest and RMS relative error, |a_bh - a_direct| / |a_direct| over all bodies.
+ * Exits with 1 when the largest error is above the bound, so it doubles as a regression test (ctest runs it on objects.json).
+ * Usage: barneshut_check [objects.json path] [theta] [max relative error]
+ */
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cmath>
+
+#include "World/Simulation.h"
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : ScenarioLoader::defaultPath;
+    double theta = argc > 2 ? std::stod(argv[2]) : 0.5;
+    double bound = argc > 3 ? std::stod(argv[3]) : 1e-3;
+
+    Simulation sim;
+    try {
+        sim.jsonToObjects(path);
+    }
+    catch (const std::exception& e) {
+        std::cout << "Failed to load scenario " << path << ": " << e.what() << std::endl;
+        return 1;
+    }
+    sim.theta = theta;
+    size_t count = sim.bodies.size();
+    if (count == 0) {
+        std::cout << path << " has no bodies" << std::endl;
+        return 1;
+    }
+
+    Accelerations direct, approximate;
+    direct.resize(count);
+    approximate.resize(count);
+    sim.computeDirect(sim.bodies, direct);
+    sim.computeBarnesHut(sim.bodies, approximate);
+
+    double maxError = 0.0, sumSquared = 0.0;
+    size_t worst = 0;
+    for (size_t i = 0; i < count; i++) {
+        glm::dvec3 exact(direct.x[i], direct.y[i], direct.z[i]);
+        glm::dvec3 difference = glm::dvec3(approximate.x[i], approximate.y[i], approximate.z[i]) - exact;
+        double magnitude = glm::length(exact);
+        double error = magnitude > 0.0 ? glm::length(difference) / magnitude : glm::length(difference);
+        sumSquared += error * error;
+        if (error > maxError) {
+            maxError = error;
+            worst = i;
+        }
+    }
+
+    std::printf("%zu bodies, theta %.3f: max relative error %.3e (body %zu), rms %.3e, bound %.3e\n", count, theta, maxError, worst,
+                std::sqrt(sumSquared / count), bound);
+    if (!(maxError <= bound)) {
+        std::printf("FAILED: Barnes-Hut error is above the bound\n");
+        return 1;
+    }
+    std::printf("OK\n");
+    return 0;
+}
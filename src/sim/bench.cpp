@@ -0,0 +1,394 @@
+/*
+ * Reproducible benchmark suite, results are written as JSON so runs can be compared across commits.
+ * Every workload is generated from a fixed seed, so two runs on one machine time exactly the same work.
+ *
+ *   step        simulationUpdate() throughput at N = 10, 1k, 10k and 100k for every force method
+ *   trail       RenderTable::logTrailPoints() cost per point
+ *   load        jsonToObjects() on a generated scenario, and Checkpoint write and read
+ *   snapshot    writeSnapshot() cost, what the simulation thread pays to publish a frame
+ *   render      Renderer::drawBuffers() submission into a hidden window, skipped when no display is available
+ *
+ * Usage: bench [--output path] [--label text] [--min-seconds t] [--max-bodies n] [--threads n] [--no-render]
+ * Without --output the JSON goes to stdout and progress to stderr.
+ */
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+#include <cmath>
+#include <stdexcept>
+
+#include <json.hpp>
+
+#include "World/Simulation.h"
+#include "IO/Checkpoint.h"
+#include "Graphics/Renderer.h"
+
+struct BenchOptions {
+    std::string output;
+    std::string label;
+    double minSeconds = 0.5;
+    size_t maxBodies = 100000;
+    unsigned threads = std::thread::hardware_concurrency();
+    bool render = true;
+};
+
+/**
+ * Per iteration wall clock times of one benchmark
+ */
+struct Timing {
+    std::vector<double> seconds;
+
+    double median() const {
+        std::vector<double> sorted = seconds;
+        std::sort(sorted.begin(), sorted.end());
+        size_t middle = sorted.size() / 2;
+        return sorted.size() % 2 ? sorted[middle] : 0.5 * (sorted[middle - 1] + sorted[middle]);
+    }
+
+    double min() const {
+        return *std::min_element(seconds.begin(), seconds.end());
+    }
+
+    double mean() const {
+        double total = 0.0;
+        for (double s : seconds) total += s;
+        return total / seconds.size();
+    }
+};
+
+/**
+ * Runs body once untimed, then repeatedly until minSeconds have gone by and at least minIterations were timed
+ */
+template <typename Body>
+Timing measure(double minSeconds, int minIterations, Body&& body) {
+    body();
+    Timing timing;
+    double total = 0.0;
+    while (total < minSeconds || static_cast<int>(timing.seconds.size()) < minIterations) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        timing.seconds.push_back(elapsed);
+        total += elapsed;
+    }
+    return timing;
+}
+
+/**
+ * Result entry with the timing summary every benchmark shares, callers add their own throughput fields
+ */
+json result(const std::string& name, const Timing& timing) {
+    return {
+        { "name", name },
+        { "iterations", timing.seconds.size() },
+        { "median_seconds", timing.median() },
+        { "min_seconds", timing.min() },
+        { "mean_seconds", timing.mean() },
+    };
+}
+
+/**
+ * A star with count - 1 bodies on circular orbits in a thin disk, the same bodies for the same count on every run
+ */
+void buildDisk(Simulation& sim, size_t count) {
+    std::mt19937_64 gen(42);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const double starMass = 1.98841e30;
+    const double innerRadius = 5e10, outerRadius = 5e12;
+
+    sim.bodies.reserve(count);
+    sim.render.reserve(count);
+    sim.addObject(CelestialObject(glm::dvec3(0.0), glm::dvec3(0.0), starMass, 6.957e8, glm::vec3(1.0f, 1.0f, 0.0f)));
+    for (size_t i = 1; i < count; i++) {
+        double r = innerRadius + (outerRadius - innerRadius) * unit(gen);
+        double angle = 2.0 * M_PI * unit(gen);
+        double height = r * 0.02 * (unit(gen) - 0.5);
+        double speed = std::sqrt(sim.G * starMass / r);
+        glm::dvec3 position(r * std::cos(angle), r * std::sin(angle), height);
+        glm::dvec3 velocity(-speed * std::sin(angle), speed * std::cos(angle), 0.0);
+        sim.addObject(CelestialObject(position, velocity, 1e20 + 1e23 * unit(gen), 1e6, glm::vec3(0.5f)));
+    }
+}
+
+json benchSteps(const BenchOptions& options) {
+    json results = json::array();
+    for (size_t count : { size_t(10), size_t(1000), size_t(10000), size_t(100000) }) {
+        if (count > options.maxBodies) continue;
+        for (ForceMethod method : { ForceMethod::Direct, ForceMethod::BarnesHut }) {
+            const char* methodName = method == ForceMethod::Direct ? "direct" : "barneshut";
+            std::cerr << "step " << methodName << " N=" << count << std::endl;
+
+            Simulation sim;
+            buildDisk(sim, count);
+            sim.forceMethod = method;
+            sim.dt = 3600.0;
+            sim.setThreadCount(options.threads);
+
+            uint64_t evaluations = sim.forceEvaluations;
+            Timing timing = measure(options.minSeconds, 3, [&] { sim.simulationUpdate(); });
+            double perStep = static_cast<double>(sim.forceEvaluations - evaluations) / (timing.seconds.size() + 1);
+
+            json entry = result("step", timing);
+            entry["force"] = methodName;
+            entry["integrator"] = sim.integrator->name();
+            entry["bodies"] = count;
+            entry["steps_per_second"] = 1.0 / timing.median();
+            entry["body_updates_per_second"] = perStep / timing.median();
+            results.push_back(entry);
+        }
+    }
+    return results;
+}
+
+json benchTrails(const BenchOptions& options) {
+    size_t count = std::min<size_t>(10000, options.maxBodies);
+    std::cerr << "trail N=" << count << std::endl;
+    Simulation sim;
+    buildDisk(sim, count);
+    SimulationSnapshot snapshot;
+    sim.writeSnapshot(snapshot);
+
+    Timing timing = measure(options.minSeconds, 10, [&] { sim.render.logTrailPoints(snapshot); });
+    json entry = result("trail_append", timing);
+    entry["bodies"] = count;
+    entry["trail_capacity"] = sim.render.trails[0].capacity();
+    entry["nanoseconds_per_point"] = timing.median() / count * 1e9;
+    return entry;
+}
+
+json benchSnapshot(const BenchOptions& options) {
+    size_t count = options.maxBodies;
+    std::cerr << "snapshot N=" << count << std::endl;
+    Simulation sim;
+    buildDisk(sim, count);
+    SimulationSnapshot snapshot;
+
+    Timing timing = measure(options.minSeconds, 10, [&] { sim.writeSnapshot(snapshot); });
+    json entry = result("snapshot_write", timing);
+    entry["bodies"] = count;
+    return entry;
+}
+
+json benchLoad(const BenchOptions& options) {
+    json results = json::array();
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    size_t count = std::min<size_t>(100000, options.maxBodies);
+
+    // Scenario JSON in the objects.json layout
+    std::cerr << "load json N=" << count << std::endl;
+    std::string scenarioPath = (directory / "bench_scenario.json").string();
+    {
+        Simulation source;
+        buildDisk(source, count);
+        json objects = json::array();
+        for (size_t i = 0; i < count; i++) {
+            objects.push_back({
+                { "name", "Body " + std::to_string(i) },
+                { "mass", source.bodies.mass[i] },
+                { "radius", source.bodies.radius[i] / 1000.0 },
+                { "X", source.bodies.x[i] / 1000.0 }, { "Y", source.bodies.y[i] / 1000.0 }, { "Z", source.bodies.z[i] / 1000.0 },
+                { "VX", source.bodies.vx[i] / 1000.0 }, { "VY", source.bodies.vy[i] / 1000.0 }, { "VZ", source.bodies.vz[i] / 1000.0 },
+                { "color", i == 0 ? "YELLOW" : "GREY" },
+            });
+        }
+        std::ofstream out(scenarioPath);
+        out << json{ { "count", count }, { "objects", objects } }.dump(4);
+    }
+    double scenarioBytes = static_cast<double>(std::filesystem::file_size(scenarioPath));
+    Timing jsonTiming = measure(options.minSeconds, 3, [&] {
+        Simulation sim;
+        sim.jsonToObjects(scenarioPath);
+    });
+    json entry = result("load_json", jsonTiming);
+    entry["bodies"] = count;
+    entry["bytes"] = scenarioBytes;
+    entry["megabytes_per_second"] = scenarioBytes / jsonTiming.median() / 1e6;
+    results.push_back(entry);
+    std::filesystem::remove(scenarioPath);
+
+    // Binary checkpoint round trip at the largest body count
+    count = options.maxBodies;
+    std::cerr << "load checkpoint N=" << count << std::endl;
+    std::string checkpointPath = (directory / "bench_checkpoint.ckpt").string();
+    Simulation source;
+    buildDisk(source, count);
+    Timing writeTiming = measure(options.minSeconds, 3, [&] { Checkpoint::write(source, checkpointPath); });
+    double checkpointBytes = static_cast<double>(std::filesystem::file_size(checkpointPath));
+    Timing readTiming = measure(options.minSeconds, 3, [&] {
+        Simulation sim;
+        Checkpoint::read(sim, checkpointPath);
+    });
+    std::filesystem::remove(checkpointPath);
+
+    for (auto [name, timing] : { std::pair{ "checkpoint_write", &writeTiming }, std::pair{ "checkpoint_read", &readTiming } }) {
+        json checkpoint = result(name, *timing);
+        checkpoint["bodies"] = count;
+        checkpoint["bytes"] = checkpointBytes;
+        checkpoint["megabytes_per_second"] = checkpointBytes / timing->median() / 1e6;
+        results.push_back(checkpoint);
+    }
+    return results;
+}
+
+/**
+ * Times drawBuffers() plus glFinish() into a hidden window, with new positions every frame so the instance upload is included
+ * Returns an empty array when GLFW can't open a window, as on a machine without a display
+ */
+json benchRender(const BenchOptions& options) {
+    json results = json::array();
+    if (!glfwInit() || !glfwGetPrimaryMonitor()) {
+        std::cerr << "render skipped, no display" << std::endl;
+        return results;
+    }
+    // Renderer calls glfwInit() again, which keeps the hints set here
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    std::unique_ptr<Renderer> renderer;
+    try {
+        renderer = std::make_unique<Renderer>(80.0f, 15);
+    }
+    catch (...) {
+        std::cerr << "render skipped, no OpenGL context" << std::endl;
+        return results;
+    }
+    glfwSwapInterval(0);
+    glEnable(GL_DEPTH_TEST);
+
+    for (size_t count : { size_t(1000), size_t(10000) }) {
+        if (count > options.maxBodies) continue;
+        std::cerr << "render N=" << count << std::endl;
+        Simulation sim;
+        buildDisk(sim, count);
+        renderer->bufferObjects(sim);
+        // Two snapshots a step apart, alternated so every frame sees new positions and re-uploads the instances
+        SimulationSnapshot snapshots[2];
+        sim.writeSnapshot(snapshots[0]);
+        sim.simulationUpdate();
+        sim.writeSnapshot(snapshots[1]);
+        size_t frame = 0;
+
+        Timing timing = measure(options.minSeconds, 10, [&] {
+            const SimulationSnapshot& snapshot = snapshots[frame++ % 2];
+            sim.render.logTrailPoints(snapshot);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderer->drawBuffers(snapshot, sim.render);
+            glFinish();
+        });
+        json entry = result("render_frame", timing);
+        entry["bodies"] = count;
+        entry["frames_per_second"] = 1.0 / timing.median();
+        // Bodies left after frustum culling, what the timed draws actually submitted
+        entry["visible_bodies"] = renderer->instances.size();
+        results.push_back(entry);
+
+        // Release this count's trail buffers before the next
+        glDeleteBuffers(static_cast<GLsizei>(sim.render.trail_VBO.size()), sim.render.trail_VBO.data());
+        glDeleteVertexArrays(static_cast<GLsizei>(sim.render.trail_VAO.size()), sim.render.trail_VAO.data());
+    }
+    glfwTerminate();
+    return results;
+}
+
+bool parseOptions(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--no-render") {
+            options.render = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        // The numeric conversions throw on text that isn't a number or doesn't fit, stoul also wraps negative numbers around
+        bool valid = true;
+        try {
+            if (arg == "--output") options.output = value;
+            else if (arg == "--label") options.label = value;
+            else if (arg == "--min-seconds") {
+                options.minSeconds = std::stod(value);
+                valid = std::isfinite(options.minSeconds) && options.minSeconds >= 0.0;
+            }
+            else if (arg == "--max-bodies") {
+                valid = value[0] != '-';
+                options.maxBodies = std::max<size_t>(10, std::stoul(value));
+            }
+            else if (arg == "--threads") {
+                valid = value[0] != '-';
+                options.threads = std::stoul(value);
+                valid = valid && options.threads >= 1;
+            }
+            else {
+                std::cerr << "Unknown option " << arg << std::endl;
+                return false;
+            }
+        }
+        catch (const std::logic_error&) {
+            valid = false;
+        }
+        if (!valid) {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: bench [--output path] [--label text] [--min-seconds t] [--max-bodies n] [--threads n] [--no-render]" << std::endl;
+        return 1;
+    }
+
+    json report;
+    report["schema"] = 1;
+    report["label"] = options.label;
+    report["timestamp"] = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    report["threads"] = options.threads;
+    report["kernel"] = GravityKernel::name(GravityKernel().isa);
+#if defined(__clang__)
+    report["compiler"] = "clang " __clang_version__;
+#elif defined(__GNUC__)
+    report["compiler"] = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    report["compiler"] = "msvc " + std::to_string(_MSC_VER);
+#endif
+#ifdef NDEBUG
+    report["optimized"] = true;
+#else
+    report["optimized"] = false;
+#endif
+
+    json results = json::array();
+    for (const json& entry : benchSteps(options)) results.push_back(entry);
+    results.push_back(benchTrails(options));
+    results.push_back(benchSnapshot(options));
+    for (const json& entry : benchLoad(options)) results.push_back(entry);
+    if (options.render) {
+        for (const json& entry : benchRender(options)) results.push_back(entry);
+    }
+    report["results"] = results;
+
+    if (options.output.empty()) {
+        std::cout << report.dump(4) << std::endl;
+    }
+    else {
+        std::ofstream out(options.output);
+        out << report.dump(4) << std::endl;
+        if (!out) {
+            std::cerr << "Failed to write " << options.output << std::endl;
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * Microbenchmark for the direct summation GravityKernel.
+ * Times a full N x N acceleration pass with every implementation this CPU supports, in both the double precision
+ * used by the simulation and float, and reports pair-interactions per second.
+ * Usage: bench_kernel [body count] [minimum seconds per kernel]
+ */
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <string>
+#include <cstdio>
+
+#include "World/GravityKernel.h"
+
+struct KernelResult {
+    double pairsPerSecond;
+    double maxError;
+};
+
+/**
+ * Runs full passes until minSeconds have gone by, error is measured against the double precision scalar reference
+ */
+template <typename T>
+KernelResult runKernel(const GravityKernel& kernel, const std::vector<double>& xs, const std::vector<double>& ys, const std::vector<double>& zs,
+                       const std::vector<double>& ms, const std::vector<glm::dvec3>& reference, double minSeconds) {
+    size_t count = xs.size();
+    std::vector<T> x(xs.begin(), xs.end()), y(ys.begin(), ys.end()), z(zs.begin(), zs.end()), m(ms.begin(), ms.end());
+    std::vector<glm::vec<3, T>> result(count);
+    const T G = T(6.6743e-11);
+    const T softening = T(1000.0);
+
+    int passes = 0;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    do {
+        for (size_t i = 0; i < count; i++) {
+            result[i] = kernel.acceleration(x.data(), y.data(), z.data(), m.data(), count, x[i], y[i], z[i], G, softening);
+        }
+        passes++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < minSeconds);
+
+    double maxError = 0.0;
+    for (size_t i = 0; i < count && !reference.empty(); i++) {
+        double error = glm::length(glm::dvec3(result[i]) - reference[i]) / glm::length(reference[i]);
+        if (error > maxError) maxError = error;
+    }
+    return { static_cast<double>(count) * count * passes / elapsed, maxError };
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 4096;
+    double minSeconds = argc > 2 ? std::stod(argv[2]) : 1.0;
+
+    // Random bodies spread over a solar system sized volume
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> position(-1e12, 1e12);
+    std::uniform_real_distribution<double> mass(1e20, 1e25);
+    std::vector<double> x(count), y(count), z(count), m(count);
+    for (size_t i = 0; i < count; i++) {
+        x[i] = position(gen);
+        y[i] = position(gen);
+        z[i] = position(gen);
+        m[i] = mass(gen);
+    }
+
+    std::vector<glm::dvec3> reference(count);
+    GravityKernel scalar(KernelIsa::Scalar);
+    for (size_t i = 0; i < count; i++) {
+        reference[i] = scalar.acceleration(x.data(), y.data(), z.data(), m.data(), count, x[i], y[i], z[i], 6.6743e-11, 1000.0);
+    }
+
+    std::printf("%-8s %10s %14s %14s %14s %14s %10s\n", "kernel", "bodies", "float pairs/s", "double pairs/s", "float err", "double err", "cost");
+    for (KernelIsa isa : { KernelIsa::Scalar, KernelIsa::AVX2, KernelIsa::AVX512 }) {
+        if (!GravityKernel::supported(isa)) continue;
+        GravityKernel kernel(isa);
+
+        KernelResult single = runKernel<float>(kernel, x, y, z, m, reference, minSeconds);
+        KernelResult dual = runKernel<double>(kernel, x, y, z, m, reference, minSeconds);
+        std::printf("%-8s %10zu %14.4g %14.4g %14.3g %14.3g %9.2fx\n", GravityKernel::name(isa), count,
+                    single.pairsPerSecond, dual.pairsPerSecond, single.maxError, dual.maxError, single.pairsPerSecond / dual.pairsPerSecond);
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ * Energy and angular momentum drift report for every integrator.
+ * Integrates the objects.json system for a number of simulated years at several step sizes
+ * and prints the largest relative energy and angular momentum error seen along the way, plus the per body force evaluations spent.
+ * The block timestep integrator treats each step size as its coarsest rung, rkf78 as the interval it adapts substeps within.
+ * Usage: drift_report [objects.json path] [years]
+ */
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+
+#include "World/Simulation.h"
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : ScenarioLoader::defaultPath;
+    double years = argc > 2 ? std::stod(argv[2]) : 100.0;
+
+    const double secondsPerYear = 365.25 * 86400.0;
+    const double stepSizes[] = { 1440.0, 3600.0 * 6, 86400.0, 86400.0 * 4 };
+    const int samplesPerRun = 1000;
+
+    std::printf("%-10s %10s %12s %14s %14s %14s %10s\n", "integrator", "dt [s]", "steps", "max |dE/E0|", "max |dL|/|L0|", "force evals", "wall [s]");
+    for (IntegratorType type : { IntegratorType::SemiImplicitEuler, IntegratorType::Leapfrog, IntegratorType::Yoshida4, IntegratorType::BlockTimestep, IntegratorType::RKF78 }) {
+        for (double dt : stepSizes) {
+            Simulation sim;
+            sim.jsonToObjects(path);
+            sim.setIntegrator(type);
+            sim.dt = dt;
+
+            double energy0 = sim.totalEnergy();
+            glm::dvec3 momentum0 = sim.angularMomentum();
+            long long steps = static_cast<long long>(years * secondsPerYear / dt);
+            long long sampleEvery = std::max(1LL, steps / samplesPerRun);
+            double maxEnergyError = 0.0, maxMomentumError = 0.0;
+
+            auto start = std::chrono::steady_clock::now();
+            for (long long s = 1; s <= steps; s++) {
+                sim.simulationUpdate();
+                if (s % sampleEvery == 0 || s == steps) {
+                    maxEnergyError = std::max(maxEnergyError, std::abs((sim.totalEnergy() - energy0) / energy0));
+                    maxMomentumError = std::max(maxMomentumError, glm::length(sim.angularMomentum() - momentum0) / glm::length(momentum0));
+                }
+            }
+            double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::printf("%-10s %10.0f %12lld %14.3e %14.3e %14.4g %10.2f\n", sim.integrator->name(), dt, steps, maxEnergyError, maxMomentumError,
+                        static_cast<double>(sim.forceEvaluations), wall);
+        }
+    }
+}
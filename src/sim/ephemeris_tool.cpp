@@ -0,0 +1,220 @@
+/*
+ * Offline ephemeris tool, works on caches built from Horizons vector tables or SPK kernels kept on disk (see IO/EphemerisImporter.h).
+ *
+ * Usage: ephemeris_tool <command> ...
+ *   import <cache> <input>...              Builds a cache from Horizons tables (.txt, .csv or API .json) and/or .bsp kernels
+ *   list <cache>                           Prints every body with its coverage, mass and radius
+ *   state <cache> <epoch> [id...]          Prints barycentric states in km and km/s
+ *   scenario <cache> <epoch> <out> [id...] Writes an objects.json style scenario for main and sim_headless at epoch
+ *   validate <cache> <epoch> <days> [dt]   Integrates the bodies from epoch and reports their largest distance from the ephemeris
+ *
+ * Epochs are "YYYY-MM-DD[THH:MM[:SS]]" (TDB) or "JD<julian date>". Without ids every body with a mass that is covered at the epoch
+ * is used, except barycenters whose planet or moons are in the cache too and the solar system barycenter itself.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+
+#include <json.hpp>
+
+#include "IO/EphemerisImporter.h"
+#include "IO/EphemerisCache.h"
+#include "World/Simulation.h"
+
+void printUsage() {
+    std::cout << "Usage: ephemeris_tool import <cache> <input>..." << std::endl
+              << "       ephemeris_tool list <cache>" << std::endl
+              << "       ephemeris_tool state <cache> <epoch> [id...]" << std::endl
+              << "       ephemeris_tool scenario <cache> <epoch> <objects.json> [id...]" << std::endl
+              << "       ephemeris_tool validate <cache> <epoch> <days> [dt seconds]" << std::endl
+              << "Epochs are YYYY-MM-DD[THH:MM[:SS]] (TDB) or JD<julian date>" << std::endl;
+}
+
+/**
+ * The explicitly listed ids, or every massive body covered at time that isn't a barycenter of bodies also in the cache
+ */
+std::vector<int32_t> selectBodies(const EphemerisCache& cache, double time, int argc, char** argv, int firstId) {
+    std::vector<int32_t> ids;
+    for (int i = firstId; i < argc; i++) {
+        ids.push_back(std::stoi(argv[i]));
+    }
+    if (!ids.empty()) return ids;
+
+    for (size_t b = 0; b < cache.bodyCount(); b++) {
+        const EphemerisBody& body = cache.body(b);
+        if (body.id == 0 || body.mass <= 0.0 || !cache.covers(body.id, time)) continue;
+        if (body.id >= 1 && body.id <= 9) {
+            // Planet barycenter, members are 100 * id to 100 * id + 99
+            bool members = false;
+            for (size_t m = 0; m < cache.bodyCount(); m++) {
+                const EphemerisBody& member = cache.body(m);
+                members |= member.id >= body.id * 100 && member.id < body.id * 100 + 100 && member.mass > 0.0 && cache.covers(member.id, time);
+            }
+            if (members) continue;
+        }
+        ids.push_back(body.id);
+    }
+    return ids;
+}
+
+std::string colorOf(int32_t id) {
+    const EphemerisImporter::KnownBody* known = EphemerisImporter::knownBody(id);
+    return known ? known->color : "WHITE";
+}
+
+int importCommand(int argc, char** argv) {
+    if (argc < 4) {
+        printUsage();
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    EphemerisImporter importer;
+    for (int i = 3; i < argc; i++) {
+        size_t segments = importer.addFile(argv[i]);
+        std::cout << argv[i] << ": " << segments << " segment(s)" << std::endl;
+    }
+    for (const std::string& warning : importer.warnings) {
+        std::cout << "Warning: " << warning << std::endl;
+    }
+    importer.write(argv[2]);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("Wrote %zu bodies to %s in %.3f s\n", importer.bodyCount(), argv[2], seconds);
+    return 0;
+}
+
+int listCommand(const EphemerisCache& cache) {
+    std::printf("%8s  %-26s %-19s  %-19s %12s %10s %9s\n", "id", "name", "from", "to", "mass [kg]", "radius[km]", "segments");
+    for (size_t b = 0; b < cache.bodyCount(); b++) {
+        const EphemerisBody& body = cache.body(b);
+        std::printf("%8d  %-26s %-19s  %-19s %12.5e %10.1f %9u\n", body.id, cache.name(body).c_str(),
+                    EphemerisFormat::formatEpoch(cache.startTime(body)).c_str(), EphemerisFormat::formatEpoch(cache.endTime(body)).c_str(),
+                    body.mass, body.radius / 1000.0, body.segmentCount);
+    }
+    return 0;
+}
+
+int stateCommand(const EphemerisCache& cache, double time, const std::vector<int32_t>& ids) {
+    std::printf("%s TDB (JD %.6f), barycentric ecliptic J2000\n", EphemerisFormat::formatEpoch(time).c_str(), EphemerisFormat::timeToJulianDate(time));
+    std::printf("%8s  %-26s %22s %22s %22s %16s %16s %16s\n", "id", "name", "X [km]", "Y [km]", "Z [km]", "VX [km/s]", "VY [km/s]", "VZ [km/s]");
+    int missing = 0;
+    for (int32_t id : ids) {
+        const EphemerisBody* body = cache.find(id);
+        glm::dvec3 position, velocity;
+        if (!cache.state(id, time, position, velocity)) {
+            std::printf("%8d  not covered at this epoch\n", id);
+            missing++;
+            continue;
+        }
+        position /= 1000.0;
+        velocity /= 1000.0;
+        std::printf("%8d  %-26s %22.6f %22.6f %22.6f %16.9f %16.9f %16.9f\n", id, cache.name(*body).c_str(),
+                    position.x, position.y, position.z, velocity.x, velocity.y, velocity.z);
+    }
+    return missing == 0 ? 0 : 1;
+}
+
+int scenarioCommand(const EphemerisCache& cache, double time, const std::string& path, const std::vector<int32_t>& ids) {
+    nlohmann::ordered_json objects = nlohmann::ordered_json::array();
+    for (int32_t id : ids) {
+        const EphemerisBody* body = cache.find(id);
+        glm::dvec3 position, velocity;
+        if (!cache.state(id, time, position, velocity)) {
+            std::cout << "Body " << id << " is not covered at " << EphemerisFormat::formatEpoch(time) << std::endl;
+            return 1;
+        }
+        if (body->mass <= 0.0) {
+            std::cout << "Warning: " << cache.name(*body) << " has no mass in the cache" << std::endl;
+        }
+        // Same units as objectsJSONCreator.py writes: kg, km and km/s
+        position /= 1000.0;
+        velocity /= 1000.0;
+        objects.push_back({ { "name", cache.name(*body) }, { "mass", body->mass }, { "radius", body->radius / 1000.0 },
+                            { "X", position.x }, { "Y", position.y }, { "Z", position.z },
+                            { "VX", velocity.x }, { "VY", velocity.y }, { "VZ", velocity.z }, { "color", colorOf(id) } });
+    }
+    nlohmann::ordered_json scenario = { { "count", objects.size() }, { "objects", objects } };
+    std::ofstream out(path);
+    out << scenario.dump(4) << std::endl;
+    if (!out) {
+        std::cout << "Failed to write " << path << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << objects.size() << " bodies at " << EphemerisFormat::formatEpoch(time) << " TDB to " << path << std::endl;
+    return 0;
+}
+
+int validateCommand(const EphemerisCache& cache, double time, double days, double dt, const std::vector<int32_t>& ids) {
+    Simulation sim;
+    sim.setIntegrator(IntegratorType::Yoshida4);
+    sim.dt = dt;
+    for (int32_t id : ids) {
+        const EphemerisBody* body = cache.find(id);
+        glm::dvec3 position, velocity;
+        if (!body || !cache.state(id, time, position, velocity)) {
+            std::cout << "Body " << id << " is not covered at " << EphemerisFormat::formatEpoch(time) << std::endl;
+            return 1;
+        }
+        sim.addObject(CelestialObject(position, velocity, body->mass, body->radius, Colors::colors.at(colorOf(id))));
+    }
+
+    long long steps = static_cast<long long>(days * EphemerisFormat::secondsPerDay / dt + 0.5);
+    long long sampleEvery = std::max(1LL, static_cast<long long>(EphemerisFormat::secondsPerDay / dt));
+    std::vector<double> maxError(ids.size(), 0.0), maxErrorDay(ids.size(), 0.0);
+    for (long long s = 1; s <= steps; s++) {
+        sim.simulationUpdate();
+        if (s % sampleEvery != 0 && s != steps) continue;
+        double t = time + s * dt;
+        for (size_t i = 0; i < ids.size(); i++) {
+            glm::dvec3 position, velocity;
+            if (!cache.state(ids[i], t, position, velocity)) continue;
+            double error = glm::length(sim.bodies.position(i) - position);
+            if (error > maxError[i]) {
+                maxError[i] = error;
+                maxErrorDay[i] = s * dt / EphemerisFormat::secondsPerDay;
+            }
+        }
+    }
+
+    std::printf("Integrated %lld steps of %.0f s (yoshida4, %s) from %s TDB\n", steps, dt, sim.forceMethod == ForceMethod::Direct ? "direct" : "barneshut",
+                EphemerisFormat::formatEpoch(time).c_str());
+    std::printf("%8s  %-26s %16s %10s\n", "id", "name", "max error [km]", "at day");
+    for (size_t i = 0; i < ids.size(); i++) {
+        std::printf("%8d  %-26s %16.3f %10.1f\n", ids[i], cache.name(*cache.find(ids[i])).c_str(), maxError[i] / 1000.0, maxErrorDay[i]);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+    std::string command = argv[1];
+    try {
+        if (command == "import") return importCommand(argc, argv);
+
+        EphemerisCache cache(argv[2]);
+        if (command == "list") return listCommand(cache);
+        if (argc < 4) {
+            printUsage();
+            return 1;
+        }
+        double time = EphemerisFormat::parseEpoch(argv[3]);
+        if (command == "state") return stateCommand(cache, time, selectBodies(cache, time, argc, argv, 4));
+        if (command == "scenario" && argc >= 5) return scenarioCommand(cache, time, argv[4], selectBodies(cache, time, argc, argv, 5));
+        if (command == "validate" && argc >= 5) {
+            double dt = argc >= 6 ? std::stod(argv[5]) : 3600.0;
+            return validateCommand(cache, time, std::stod(argv[4]), dt, selectBodies(cache, time, 0, argv, 0));
+        }
+    }
+    catch (const std::exception& e) {
+        std::cout << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    printUsage();
+    return 1;
+}
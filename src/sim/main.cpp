@@ -2,6 +2,15 @@
  * Re-implement delta-time for standardizing speeds across machines?
  * Delta-time can standardize times for machines that may not be able to meet the frame count.
  * With a low frame ceiling of 24 fps, machines should be able to meet these frames, don't worry about delta time for now
+ *
+ * Usage: main [--scenario path | --playback trajectory | --generate belt|disk|plummer [bodies]]
+ * Without options the scenario is ../planetData/objects.json, --scenario loads another file in the same layout.
+ * With --playback a trajectory written by sim_headless --trajectory is replayed instead of integrating live.
+ * Left and right arrows scrub through it, up and down change the playback speed.
+ * With --generate a synthetic scenario from ScenarioGenerator replaces objects.json.
+ *
+ * Built with ENABLE_PROFILER the window title shows p50/p99 milliseconds of every profiled phase,
+ * and profile.csv plus profile_trace.json (Chrome trace format) are written to the working directory on exit.
  */
 
 #include <format>
@@ -17,16 +26,24 @@
 #include <vector>
 #include <chrono>
 #include <thread>
+#include <string>
+#include <algorithm>
+#include <cstdio>
 
 #include "Graphics/Shader.h"
 #include "World/Planet.h"
 #include "World/Simulation.h"
 #include "World/Star.h"
+#include "World/SimulationThread.h"
 #include "Graphics/Renderer.h"
+#include "IO/TrajectoryReader.h"
+#include "World/ScenarioGenerator.h"
+#include "Util/Profiler.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window, Renderer& renderer);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void processPlaybackInput(GLFWwindow* window, double& playbackTime, double& playbackSpeed, double frameTime);
 
 const double frameDuration = 1.0f / 60.0f;
 double lastFrame = 0.0f;
@@ -37,13 +54,61 @@ double lastTrailTime = 0.0f;
 
 int segments = 15;
 
-int main() {
+int substepsPerFrame = 1;   // Simulation steps per rendered frame, 0 steps as fast as possible
+
+void printUsage() {
+    std::cout << "Usage: main [--scenario path | --playback trajectory | --generate belt|disk|plummer [bodies]]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    std::string playbackPath = argc > 2 && std::string(argv[1]) == "--playback" ? argv[2] : "";
+    std::string generateName = argc > 2 && std::string(argv[1]) == "--generate" ? argv[2] : "";
+    std::string scenarioPath = argc > 2 && std::string(argv[1]) == "--scenario" ? argv[2] : ScenarioLoader::defaultPath;
+    size_t generateCount = 10000;
+    if (!generateName.empty() && argc > 3) {
+        // Only --generate takes a body count
+        try {
+            size_t used = 0;
+            generateCount = std::stoul(argv[3], &used);
+            if (argv[3][used] != '\0') throw std::invalid_argument(argv[3]);
+        }
+        catch (const std::exception&) {
+            std::cout << "Invalid body count " << argv[3] << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
 
     Renderer renderer(80.0f);
 
     // std::unique_ptr<Star> star = std::make_unique<Star>(glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), segments, 1e11f, 10);
     Simulation sim;
-    sim.jsonToObjects();
+
+    // Playback reads every frame from the memory-mapped trajectory, the simulation only holds the render table
+    std::unique_ptr<TrajectoryReader> playback;
+    if (!playbackPath.empty()) {
+        playback = std::make_unique<TrajectoryReader>(playbackPath);
+        for (size_t i = 0; i < playback->bodyCount(); i++) {
+            sim.render.add(playback->color(i), static_cast<uint32_t>(i));
+        }
+    }
+    else if (!generateName.empty()) {
+        ScenarioGenerator generator(1);
+        if (!generator.addPreset(sim, generateName, generateCount)) {
+            std::cout << "Unknown generated scenario " << generateName << std::endl;
+            return 1;
+        }
+    }
+    else {
+        try {
+            ScenarioLoadStats stats = sim.jsonToObjects(scenarioPath);
+            std::printf("Loaded %zu bodies from %s (%.1f MB/s)\n", stats.bodies, scenarioPath.c_str(), stats.megabytesPerSecond());
+        }
+        catch (const std::exception& e) {
+            std::cout << "Failed to load scenario " << scenarioPath << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
 
     // sim.addObject(std::make_unique<Star>(glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), segments, 1e11f, 10, trailPollTime, trailDuration));
     // sim.addObject(std::make_unique<Planet>(glm::vec3(10.0f, 0.0f, 100.0f), glm::vec3(-0.11f, 0.0f, 0.0f), segments, 1e10, 5, trailPollTime, trailDuration));
@@ -53,33 +118,59 @@ int main() {
     // sim.addObject(std::make_unique<Star>(glm::vec3(20, 0, 0), glm::vec3(0, 0, 0.3f), segments, 1e11f, 10, trailPollTime, trailDuration));
     // sim.addObject(std::make_unique<Star>(glm::vec3(-20, 0, 0), glm::vec3(0, 0, -0.3f), segments, 1e11f, 10, trailPollTime, trailDuration));
 
-    for (std::unique_ptr<CelestialObject>& ptr : sim.objects) {
-        renderer.bufferObject(ptr);
-    }
+    renderer.bufferObjects(sim);
 
     glEnable(GL_DEPTH_TEST);
 
+    // Physics runs on its own thread from here on, the render loop only reads published snapshots
+    SimulationThread simThread(sim);
+    if (!playback) {
+        simThread.setStepsPerSecond(substepsPerFrame / frameDuration);
+        simThread.start();
+    }
+
+    // Playback starts at the live simulation's speed, in simulated seconds per wall clock second
+    SimulationSnapshot playbackSnapshot;
+    PROFILE_THREAD("render");
+#ifdef OPENGLPRACTICE_PROFILE
+    double lastProfileReport = 0.0;
+#endif
+    double playbackTime = playback ? playback->startTime() : 0.0;
+    double playbackSpeed = sim.dt * substepsPerFrame / frameDuration;
+
     while (!glfwWindowShouldClose(renderer.window)) {
         // Delta calculations
         double currentFrame = glfwGetTime();
         double timeSinceLastFrame = currentFrame - lastFrame;
         double timeSinceLastTrail = currentFrame - lastTrailTime;
 
-        // Check if the time since last trail point was added has been passed
-        if (timeSinceLastTrail > trailPollTime) {
-            sim.logTrailPoints();
-            // Update Renderer Line Buffers HERE
-            lastTrailTime = currentFrame;
-        }
-
         // Check if the next frame is ready or if a sleep is needed
         if (timeSinceLastFrame < frameDuration) {
             double timeToNextFrame = frameDuration - timeSinceLastFrame;
             std::this_thread::sleep_for(std::chrono::duration<double>(timeToNextFrame));
         }
+        PROFILE_SCOPE("frame");
+
+        // Newest state published by the simulation thread, or the trajectory sampled at the playback time
+        if (playback) {
+            processPlaybackInput(renderer.window, playbackTime, playbackSpeed, std::max(timeSinceLastFrame, frameDuration));
+            if (playbackTime > playback->endTime()) {
+                playbackTime = playback->startTime();
+            }
+            playbackTime = std::clamp(playbackTime, playback->startTime(), playback->endTime());
+            playback->sample(playbackTime, playbackSnapshot);
+        }
+        const SimulationSnapshot& snapshot = playback ? playbackSnapshot : simThread.latestSnapshot();
+        // Drop the colors and trails of bodies merged away by collisions
+        sim.render.sync(snapshot);
+        renderer.bufferObjects(sim);
 
-        // Update simulation values
-        sim.simulationUpdate();
+        // Check if the time since last trail point was added has been passed
+        if (timeSinceLastTrail > trailPollTime) {
+            sim.render.logTrailPoints(snapshot);
+            // Update Renderer Line Buffers HERE
+            lastTrailTime = currentFrame;
+        }
 
         // Read input
         processInput(renderer.window, renderer);
@@ -90,23 +181,59 @@ int main() {
 
         // Activate shader program
         // renderer.shader_setup();
-        renderer.drawBuffers(sim);
+        renderer.drawBuffers(snapshot, sim.render);
 
         // Update last time on successful frame gen
         lastFrame = glfwGetTime();
 
         // Boilerplate
-        glfwSwapBuffers(renderer.window);
+        {
+            PROFILE_SCOPE("swap");
+            glfwSwapBuffers(renderer.window);
+        }
         glfwPollEvents();
 
+#ifdef OPENGLPRACTICE_PROFILE
+        if (currentFrame - lastProfileReport > 1.0) {
+            glfwSetWindowTitle(renderer.window, Profiler::instance().overlay().c_str());
+            lastProfileReport = currentFrame;
+        }
+#endif
     }
 
+    simThread.stop();
+#ifdef OPENGLPRACTICE_PROFILE
+    Profiler::instance().writeCsv("profile.csv");
+    Profiler::instance().writeChromeTrace("profile_trace.json");
+#endif
+
 }
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     glViewport(0, 0, width, height);
 }
 
+/**
+ * Advances the playback clock by one frame, the arrow keys scrub and change speed
+ */
+void processPlaybackInput(GLFWwindow* window, double& playbackTime, double& playbackSpeed, double frameTime) {
+    const double scrubMultiplier = 50.0;
+    double direction = 1.0;
+    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
+        direction = scrubMultiplier;
+    }
+    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) {
+        direction = -scrubMultiplier;
+    }
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
+        playbackSpeed *= 1.05;
+    }
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
+        playbackSpeed /= 1.05;
+    }
+    playbackTime += direction * playbackSpeed * frameTime;
+}
+
 void processInput(GLFWwindow* window, Renderer& renderer) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, GLFW_TRUE);
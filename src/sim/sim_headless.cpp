@@ -0,0 +1,297 @@
+/*
+ * Headless batch runner, integrates a scenario as fast as the CPU allows without creating a window or GL context.
+ * Periodically writes the state of every body to a CSV file and prints progress to stdout.
+ *
+ * Usage: sim_headless [options]
+ *   --scenario <path>      Scenario JSON file (default ../planetData/objects.json)
+ *   --generate <name>      Generate a belt, disk or plummer scenario instead of loading one (see ScenarioGenerator::addPreset)
+ *   --bodies <n>           Generated bodies (default 100000)
+ *   --seed <n>             Generator seed (default 1)
+ *   --steps <n>            Number of steps to integrate
+ *   --years <t>            Simulated years to integrate, used when --steps is not given (default 1)
+ *   --dt <seconds>         Step size (default 1440)
+ *   --integrator <name>    euler, leapfrog, yoshida4, block or rkf78 (default leapfrog)
+ *                          block treats --dt as its coarsest step, rkf78 as the interval it adapts substeps within
+ *   --force <name>         direct or barneshut (default direct)
+ *   --theta <value>        Barnes-Hut opening angle (default 0.5)
+ *   --threads <n>          Force evaluation threads (default all hardware threads)
+ *   --output <path>        CSV file for periodic state output, none when omitted
+ *   --output-every <n>     Steps between outputs (default 1000)
+ *   --checkpoint <path>    Binary checkpoint file, rewritten every --checkpoint-every steps and at the end of the run
+ *   --checkpoint-every <n> Steps between checkpoints (default 100000)
+ *   --trajectory <path>    Chunked binary trajectory file, written from a background thread (see IO/TrajectoryFormat.h)
+ *   --trajectory-every <n> Steps between trajectory frames (default 100)
+ *   --collisions <name>    none, merge or bounce (default none), merged bodies are removed from the run
+ *   --restart <path>       Resume from a checkpoint instead of loading a scenario, dt, integrator, force and collision settings come from the file
+ *   --energy <mode>        auto, on or off (default auto), whether the final report includes the total energy.
+ *                          It is an O(N^2) sum, auto only computes it up to energyReportLimit bodies
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <stdexcept>
+
+#include "World/Simulation.h"
+#include "World/ScenarioGenerator.h"
+#include "IO/Checkpoint.h"
+#include "IO/TrajectoryWriter.h"
+
+enum class EnergyReport { Auto, On, Off };
+
+// Largest body count --energy auto still reports the energy for, the pair sum takes about a second here
+constexpr size_t energyReportLimit = 20000;
+
+struct HeadlessOptions {
+    std::string scenario = ScenarioLoader::defaultPath;
+    std::string generate;
+    size_t bodies = 100000;
+    uint64_t seed = 1;
+    long long steps = -1;
+    double years = 1.0;
+    double dt = 1440.0;
+    IntegratorType integrator = IntegratorType::Leapfrog;
+    ForceMethod forceMethod = ForceMethod::Direct;
+    float theta = 0.5f;
+    unsigned threads = std::thread::hardware_concurrency();
+    std::string output;
+    long long outputEvery = 1000;
+    std::string checkpoint;
+    long long checkpointEvery = 100000;
+    std::string restart;
+    std::string trajectory;
+    long long trajectoryEvery = 100;
+    CollisionResponse collisions = CollisionResponse::None;
+    EnergyReport energy = EnergyReport::Auto;
+};
+
+void printUsage() {
+    std::cout << "Usage: sim_headless [--scenario path | --generate belt|disk|plummer [--bodies n] [--seed n]] [--steps n | --years t] [--dt seconds] [--integrator euler|leapfrog|yoshida4|block|rkf78]" << std::endl
+              << "                    [--force direct|barneshut] [--theta value] [--threads n] [--output path] [--output-every n]" << std::endl
+              << "                    [--checkpoint path] [--checkpoint-every n] [--trajectory path] [--trajectory-every n] [--restart path]" << std::endl
+              << "                    [--collisions none|merge|bounce] [--energy auto|on|off]" << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, HeadlessOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            std::cout << "Missing value for " << arg << std::endl;
+            return false;
+        }
+
+        std::string value = argv[++i];
+        // The numeric conversions throw on text that isn't a number or doesn't fit
+        try {
+            if (arg == "--scenario") options.scenario = value;
+            else if (arg == "--generate") options.generate = value;
+            else if (arg == "--bodies") options.bodies = std::stoull(value);
+            else if (arg == "--seed") options.seed = std::stoull(value);
+            else if (arg == "--steps") options.steps = std::stoll(value);
+            else if (arg == "--years") options.years = std::stod(value);
+            else if (arg == "--dt") options.dt = std::stod(value);
+            else if (arg == "--theta") options.theta = std::stof(value);
+            else if (arg == "--threads") options.threads = std::stoul(value);
+            else if (arg == "--output") options.output = value;
+            else if (arg == "--output-every") options.outputEvery = std::max(1LL, std::stoll(value));
+            else if (arg == "--checkpoint") options.checkpoint = value;
+            else if (arg == "--checkpoint-every") options.checkpointEvery = std::max(1LL, std::stoll(value));
+            else if (arg == "--restart") options.restart = value;
+            else if (arg == "--trajectory") options.trajectory = value;
+            else if (arg == "--trajectory-every") options.trajectoryEvery = std::max(1LL, std::stoll(value));
+            else if (arg == "--integrator") {
+                if (value == "euler") options.integrator = IntegratorType::SemiImplicitEuler;
+                else if (value == "leapfrog") options.integrator = IntegratorType::Leapfrog;
+                else if (value == "yoshida4") options.integrator = IntegratorType::Yoshida4;
+                else if (value == "block") options.integrator = IntegratorType::BlockTimestep;
+                else if (value == "rkf78") options.integrator = IntegratorType::RKF78;
+                else {
+                    std::cout << "Unknown integrator " << value << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--energy") {
+                if (value == "auto") options.energy = EnergyReport::Auto;
+                else if (value == "on") options.energy = EnergyReport::On;
+                else if (value == "off") options.energy = EnergyReport::Off;
+                else {
+                    std::cout << "Unknown energy mode " << value << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--collisions") {
+                if (value == "none") options.collisions = CollisionResponse::None;
+                else if (value == "merge") options.collisions = CollisionResponse::Merge;
+                else if (value == "bounce") options.collisions = CollisionResponse::Bounce;
+                else {
+                    std::cout << "Unknown collision response " << value << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--force") {
+                if (value == "direct") options.forceMethod = ForceMethod::Direct;
+                else if (value == "barneshut") options.forceMethod = ForceMethod::BarnesHut;
+                else {
+                    std::cout << "Unknown force method " << value << std::endl;
+                    return false;
+                }
+            }
+            else {
+                std::cout << "Unknown option " << arg << std::endl;
+                return false;
+            }
+        }
+        catch (const std::logic_error&) {
+            std::cout << "Invalid value for " << arg << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Appends one row per body: time, body id, position and velocity
+ */
+void writeState(std::ofstream& out, const Simulation& sim) {
+    const BodyStore& bodies = sim.bodies;
+    char line[256];
+    for (size_t i = 0; i < bodies.size(); i++) {
+        int length = std::snprintf(line, sizeof(line), "%.17g,%u,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g\n", sim.time, bodies.ids[i],
+                                   bodies.x[i], bodies.y[i], bodies.z[i], bodies.vx[i], bodies.vy[i], bodies.vz[i]);
+        out.write(line, length);
+    }
+}
+
+int main(int argc, char** argv) {
+    HeadlessOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    Simulation sim;
+    if (!options.restart.empty()) {
+        try {
+            Checkpoint::read(sim, options.restart);
+        }
+        catch (const std::exception& e) {
+            std::cout << "Failed to restart from " << options.restart << ": " << e.what() << std::endl;
+            return 1;
+        }
+        std::printf("Restarted from %s at step %llu, %.3f years simulated\n", options.restart.c_str(),
+                    static_cast<unsigned long long>(sim.steps), sim.time / (365.25 * 86400.0));
+    }
+    else if (!options.generate.empty()) {
+        // Threads first, so the generator can spread the bodies over the pool
+        sim.setThreadCount(options.threads);
+        auto start = std::chrono::steady_clock::now();
+        ScenarioGenerator generator(options.seed);
+        if (!generator.addPreset(sim, options.generate, options.bodies)) {
+            std::cout << "Unknown generated scenario " << options.generate << std::endl;
+            return 1;
+        }
+        std::printf("Generated %zu bodies (%s, seed %llu) in %.3f s\n", sim.bodies.size(), options.generate.c_str(),
+                    static_cast<unsigned long long>(options.seed), std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    else {
+        try {
+            ScenarioLoadStats stats = sim.jsonToObjects(options.scenario);
+            std::printf("Loaded %zu bodies from %s (%.1f MB in %.3f s, %.1f MB/s)\n", stats.bodies, options.scenario.c_str(),
+                        stats.bytes / 1e6, stats.seconds, stats.megabytesPerSecond());
+        }
+        catch (const std::exception& e) {
+            std::cout << "Failed to load scenario " << options.scenario << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (options.restart.empty()) {
+        sim.dt = options.dt;
+        sim.setIntegrator(options.integrator);
+        sim.forceMethod = options.forceMethod;
+        sim.theta = options.theta;
+        sim.collisions.response = options.collisions;
+    }
+    sim.setThreadCount(options.threads);
+    if (sim.collisions.response == CollisionResponse::Merge && !options.trajectory.empty()) {
+        std::cout << "Trajectories need a fixed body count, --trajectory can't be combined with --collisions merge" << std::endl;
+        return 1;
+    }
+
+    long long steps = options.steps >= 0 ? options.steps : static_cast<long long>(options.years * 365.25 * 86400.0 / sim.dt);
+
+    std::ofstream out;
+    if (!options.output.empty()) {
+        out.open(options.output);
+        if (!out) {
+            std::cout << "Failed to open " << options.output << std::endl;
+            return 1;
+        }
+        out << "time,body,x,y,z,vx,vy,vz\n";
+        writeState(out, sim);
+    }
+
+    std::unique_ptr<TrajectoryWriter> trajectory;
+    if (!options.trajectory.empty()) {
+        try {
+            trajectory = std::make_unique<TrajectoryWriter>(options.trajectory, sim);
+        }
+        catch (const std::exception& e) {
+            std::cout << e.what() << std::endl;
+            return 1;
+        }
+        trajectory->append(sim);
+    }
+
+    std::cout << "Integrating " << sim.bodies.size() << " bodies for " << steps << " steps of " << sim.dt << " s with "
+              << sim.integrator->name() << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    long long reportEvery = std::max(1LL, steps / 10);
+    for (long long s = 1; s <= steps; s++) {
+        sim.simulationUpdate();
+
+        if (out.is_open() && s % options.outputEvery == 0) {
+            writeState(out, sim);
+        }
+        if (trajectory && s % options.trajectoryEvery == 0) {
+            trajectory->append(sim);
+        }
+        if (!options.checkpoint.empty() && s % options.checkpointEvery == 0 && s != steps) {
+            sim.render.sync(sim.bodies.ids, sim.topology);
+            Checkpoint::write(sim, options.checkpoint);
+        }
+        if (s % reportEvery == 0) {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::printf("step %lld / %lld, %.3f years simulated, %.0f steps/s\n", s, steps, sim.time / (365.25 * 86400.0), s / elapsed);
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!options.checkpoint.empty()) {
+        sim.render.sync(sim.bodies.ids, sim.topology);
+        Checkpoint::write(sim, options.checkpoint);
+    }
+    if (trajectory) {
+        trajectory->close();
+        std::printf("Trajectory: %llu frames, %.3f s spent waiting on the writer\n",
+                    static_cast<unsigned long long>(trajectory->frames()), trajectory->stallSeconds());
+    }
+    std::printf("Done: %lld steps in %.3f s (%.0f steps/s), %llu force evaluations\n", steps, elapsed, steps / std::max(elapsed, 1e-9),
+                static_cast<unsigned long long>(sim.forceEvaluations));
+    bool energy = options.energy == EnergyReport::On || (options.energy == EnergyReport::Auto && sim.bodies.size() <= energyReportLimit);
+    if (energy) {
+        std::printf("Energy: %.10e J\n", sim.totalEnergy());
+    }
+    else if (options.energy == EnergyReport::Auto) {
+        std::printf("Energy: skipped for %zu bodies, the O(N^2) sum only runs up to %zu without --energy on\n", sim.bodies.size(), energyReportLimit);
+    }
+    if (sim.collisions.enabled()) {
+        std::printf("Collisions: %llu, %zu bodies left\n", static_cast<unsigned long long>(sim.collisionCount), sim.bodies.size());
+    }
+}